@@ -0,0 +1,326 @@
+/*! file: bench.c
+ *
+ * kbbench driver, scene helpers and timing
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "constants.h"
+#include "state.h"
+#include "nbi.h"
+#include "msg.h"
+#include "fifo.h"
+#include "localize.h"
+#include "mask.h"
+
+#include <kilolib.h>
+
+/*! state
+ *
+ * Global state every bench runs on
+ */
+state_t state;
+
+/*! bench_robots, bench_n_robots
+ *
+ * Current scene
+ */
+bench_robot_t bench_robots[BENCH_MAX_ROBOTS];
+uint32_t bench_n_robots;
+
+/*! bench_entry_t
+ *
+ * A bench and what it measures
+ */
+typedef struct bench_entry_t {
+    const char *name;
+    void (*run)(void);
+    const char *desc;
+} bench_entry_t;
+
+/*! _benches
+ *
+ * Every bench, run in this order when none are named
+ */
+static const bench_entry_t _benches[] = {
+    { "idx", bench_idx, "id index vs linear scan lookup" },
+    { "conn", bench_conn, "frontier search vs adjacency powers" },
+    { "loc", bench_loc, "full localization pass by neighborhood size" },
+    { "adj", bench_adj, "adjacency queries" },
+    { "compact", bench_compact, "expiry with slot compaction" },
+    { "loctick", bench_loctick, "per-tick localization, incremental vs full" },
+    { "exp", bench_exp, "localization on the exp/ layouts" },
+    { "fastmath", bench_fastmath, "kb_fastmath accuracy and speed vs libm" },
+};
+
+#define N_BENCHES   (sizeof(_benches)/sizeof(_benches[0]))
+
+/*! bench_now
+ *
+ * Monotonic time in seconds
+ */
+double
+bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+/*! bench_time
+ *
+ * Run body over and over for at least BENCH_MIN_SECS
+ *
+ * Returns ns per op, with n_ops ops per run of body
+ */
+double
+bench_time(
+    bench_body_t *body,
+    void *ctx,
+    uint32_t n_ops)
+{
+    uint32_t runs = 0;
+    double t0 = bench_now();
+    double t;
+    do {
+        body(ctx);
+        ++runs;
+    } while ((t = bench_now() - t0) < BENCH_MIN_SECS);
+
+    return 1e9 * t / ((double)runs * n_ops);
+}
+
+/*! bench_reset
+ *
+ * Start over from a freshly initialized state with no neighbors
+ */
+void
+bench_reset(void)
+{
+    msg_data_t *md;
+    while (state.msg_q && (md = (msg_data_t*)fifo_pop(state.msg_q))) {
+        msg_data_delete(md);
+    }
+    kilo_ticks = 1;
+    state_init(&state);
+    state.ticks = kilo_ticks;
+}
+
+/*! bench_tick
+ *
+ * Move the clock on by one loop
+ */
+void
+bench_tick(void)
+{
+    ++kilo_ticks;
+    state.ticks = kilo_ticks;
+}
+
+/*! bench_scene
+ *
+ * Scatter n robots uniformly within comm range of us (robot 0, at the
+ * origin), no two closer than a robot's footprint where that fits.
+ * Starts over from an empty table.
+ *
+ * Returns the number of robots placed around us
+ */
+uint32_t
+bench_scene(
+    uint32_t n,
+    uint32_t seed)
+{
+    srand(seed);
+    bench_reset();
+
+    if (n >= BENCH_MAX_ROBOTS) {
+        n = BENCH_MAX_ROBOTS - 1;
+    }
+
+    bench_robots[0].id = kilo_uid;
+    bench_robots[0].pos.x = 0.0f;
+    bench_robots[0].pos.y = 0.0f;
+    bench_n_robots = 1;
+
+    float r_max = 0.9f * COMM_RANGE;
+    float sep = 20.0f;
+    for (uint32_t tries = 0; bench_n_robots <= n; ++tries) {
+        // crowd in tighter once the neighborhood won't fit otherwise
+        if (tries == 10000) {
+            tries = 0;
+            sep *= 0.8f;
+        }
+
+        point_t p;
+        p.x = r_max * (2.0f * rand() / RAND_MAX - 1.0f);
+        p.y = r_max * (2.0f * rand() / RAND_MAX - 1.0f);
+        if (hypotf(p.x, p.y) > r_max) {
+            continue;
+        }
+
+        bool crowded = false;
+        for (uint32_t k = 0; k < bench_n_robots && !crowded; ++k) {
+            crowded = hypotf(p.x - bench_robots[k].pos.x,
+                    p.y - bench_robots[k].pos.y) < sep;
+        }
+        if (crowded) {
+            continue;
+        }
+
+        bench_robots[bench_n_robots].id = (kb_id_t)(0x200 + bench_n_robots);
+        bench_robots[bench_n_robots].pos = p;
+        ++bench_n_robots;
+    }
+
+    return bench_n_robots - 1;
+}
+
+/*! bench_scene_at
+ *
+ * Take the n robots at pos (in mm) as the scene, seen from robot us:
+ * everyone is moved so that it's at the origin, and only robots that
+ * can reach us in two hops are kept. Starts over from an empty table.
+ *
+ * Returns the number of robots kept around us
+ */
+uint32_t
+bench_scene_at(
+    const point_t *pos,
+    uint32_t n,
+    uint32_t us)
+{
+    bench_reset();
+
+    bench_robots[0].id = kilo_uid;
+    bench_robots[0].pos.x = 0.0f;
+    bench_robots[0].pos.y = 0.0f;
+    bench_n_robots = 1;
+
+    for (uint32_t k = 0; k < n && bench_n_robots < BENCH_MAX_ROBOTS; ++k) {
+        point_t p = { pos[k].x - pos[us].x, pos[k].y - pos[us].y };
+        if (k == us || hypotf(p.x, p.y) >= 2.0f * COMM_RANGE) {
+            continue;
+        }
+        bench_robots[bench_n_robots].id = (kb_id_t)(0x200 + k);
+        bench_robots[bench_n_robots].pos = p;
+        ++bench_n_robots;
+    }
+
+    return bench_n_robots - 1;
+}
+
+/*! _bench_dist
+ *
+ * Measured distance between two robots of the scene
+ */
+static kb_dist_t
+_bench_dist(
+    uint32_t a,
+    uint32_t b,
+    kb_dist_t noise)
+{
+    float d = hypotf(bench_robots[a].pos.x - bench_robots[b].pos.x,
+            bench_robots[a].pos.y - bench_robots[b].pos.y);
+    if (noise) {
+        d += (float)(rand() % (2*noise + 1)) - noise;
+    }
+    return (kb_dist_t)((d < 1.0f)? 1.0f : d + 0.5f);
+}
+
+/*! _bench_apply
+ *
+ * Run everything staged through the loop's rx path, and throw away the
+ * gossip it queued
+ */
+static void
+_bench_apply(void)
+{
+    msg_rx_apply(&state);
+
+    msg_data_t *md;
+    while ((md = (msg_data_t*)fifo_pop(state.msg_q))) {
+        msg_data_delete(md);
+    }
+}
+
+/*! bench_hear
+ *
+ * One round of messages: every robot in comm range of us sends its id,
+ * and one message for each robot in comm range of it
+ */
+void
+bench_hear(kb_dist_t noise)
+{
+    for (uint32_t k = 1; k < bench_n_robots; ++k) {
+        kb_dist_t d = _bench_dist(0, k, 0);
+        if (d >= COMM_RANGE) {
+            continue;
+        }
+
+        while (!nbi_rx_push(state.nbi, bench_robots[k].id,
+                    _bench_dist(0, k, noise), KB_ID_INVALID, 0)) {
+            _bench_apply();
+        }
+
+        for (uint32_t o = 0; o < bench_n_robots; ++o) {
+            if (o == k || _bench_dist(k, o, 0) >= COMM_RANGE) {
+                continue;
+            }
+            while (!nbi_rx_push(state.nbi, bench_robots[k].id,
+                        _bench_dist(0, k, noise), bench_robots[o].id,
+                        _bench_dist(k, o, noise))) {
+                _bench_apply();
+            }
+        }
+    }
+    _bench_apply();
+}
+
+/*! bench_localize_full
+ *
+ * Localization pass that redoes every neighbor from scratch, as if
+ * the whole table had changed since the last one
+ */
+void
+bench_localize_full(void)
+{
+    nbrs_info_t *nbi = state.nbi;
+    nbi->loc_dirty = MASK_LOW(nbi->n_nbrs);
+    nbi->localized_gen = nbi_get_gen(nbi) + 1;
+    localize_all(&state, LOC_MAX_REFS);
+}
+
+int
+main(int argc, char **argv)
+{
+    printf("kbbench: MAX_NEIGHBORS %u\n", (uint32_t)MAX_NEIGHBORS);
+
+    if (argc < 2) {
+        for (uint32_t b = 0; b < N_BENCHES; ++b) {
+            printf("\n%s: %s\n", _benches[b].name, _benches[b].desc);
+            _benches[b].run();
+        }
+        return 0;
+    }
+
+    for (int a = 1; a < argc; ++a) {
+        uint32_t b = 0;
+        while (b < N_BENCHES && strcmp(argv[a], _benches[b].name) != 0) {
+            ++b;
+        }
+        if (b == N_BENCHES) {
+            fprintf(stderr, "kbbench: no bench %s\n", argv[a]);
+            return 1;
+        }
+        printf("\n%s: %s\n", _benches[b].name, _benches[b].desc);
+        _benches[b].run();
+    }
+
+    return 0;
+}
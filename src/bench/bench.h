@@ -0,0 +1,74 @@
+/*! file: bench.h
+ *
+ * Offline benchmarks for the neighbor table and localization. Scenes
+ * are built on the global state the same way the loop builds them (rx
+ * ring, then msg_rx_apply), so the timed code is exactly what runs on
+ * the robot. Only neighborhoods that fit in MAX_NEIGHBORS are run;
+ * configure with KB_MAX_NEIGHBORS=64 to get every row.
+ *
+ * usage: kbbench [bench name]...
+ */
+
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include "types.h"
+
+// forward declarations
+typedef struct state_t state_t;
+
+/*! bench_robot_t
+ *
+ * A robot in a bench scene. Robot 0 is us.
+ */
+typedef struct bench_robot_t {
+    kb_id_t id;
+    point_t pos;
+} bench_robot_t;
+
+#define BENCH_MAX_ROBOTS    512
+
+/*! bench_robots, bench_n_robots
+ *
+ * Current scene
+ */
+extern bench_robot_t bench_robots[BENCH_MAX_ROBOTS];
+extern uint32_t bench_n_robots;
+
+/*! state
+ *
+ * Global state every bench runs on
+ */
+extern state_t state;
+
+/*! bench_body_t
+ *
+ * Code under test, run repeatedly by bench_time
+ */
+typedef void bench_body_t(void *ctx);
+
+#define BENCH_MIN_SECS      0.2
+
+// Timing
+double bench_now(void);
+double bench_time(bench_body_t *body, void *ctx, uint32_t n_ops);
+
+// Scenes
+void bench_reset(void);
+void bench_tick(void);
+uint32_t bench_scene(uint32_t n, uint32_t seed);
+uint32_t bench_scene_at(const point_t *pos, uint32_t n, uint32_t us);
+void bench_hear(kb_dist_t noise);
+void bench_localize_full(void);
+
+// Benches
+void bench_idx(void);
+void bench_conn(void);
+void bench_loc(void);
+void bench_adj(void);
+void bench_compact(void);
+void bench_loctick(void);
+void bench_exp(void);
+void bench_fastmath(void);
+
+#endif
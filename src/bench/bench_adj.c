@@ -0,0 +1,98 @@
+/*! file: bench_adj.c
+ *
+ * Adjacency queries in whichever representation this build keeps
+ * (word rows by default, bitmat_t with NBI_ADJ_BITMAT). Build both ways
+ * to compare.
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+
+#include "constants.h"
+#include "state.h"
+#include "nbi.h"
+#include "nbr.h"
+#include "localize.h"
+
+static void
+_run_is_adj(void *ctx)
+{
+    (void)ctx;
+    nbrs_info_t *nbi = state.nbi;
+    volatile uint32_t sink = 0;
+    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
+        for (uint32_t j = 0; j < nbi->n_nbrs; ++j) {
+            sink += nbi_is_adj(nbi, i, j);
+        }
+    }
+    (void)sink;
+}
+
+static void
+_run_find(void *ctx)
+{
+    (void)ctx;
+    nbrs_info_t *nbi = state.nbi;
+    volatile uint32_t sink = 0;
+    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
+        uint32_t j = nbi_find_nbr(nbi, i, 0, NBR_LOCALIZED);
+        while (j != INVALID_INDEX) {
+            sink += j;
+            j = nbi_find_nbr(nbi, i, j + 1, NBR_LOCALIZED);
+        }
+    }
+    (void)sink;
+}
+
+static void
+_run_degree(void *ctx)
+{
+    (void)ctx;
+    nbrs_info_t *nbi = state.nbi;
+    volatile uint32_t sink = 0;
+    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
+        sink += nbi_get_degree(nbi, i);
+    }
+    (void)sink;
+}
+
+static void
+_run_full(void *ctx)
+{
+    (void)ctx;
+    bench_localize_full();
+}
+
+void
+bench_adj(void)
+{
+    static const uint32_t sizes[] = { 16, 32, 64 };
+
+#ifdef NBI_ADJ_BITMAT
+    printf("adjacency: bitmat_t\n");
+#else
+    printf("adjacency: word rows\n");
+#endif
+    printf("%8s %10s %12s %10s %12s\n", "nbrs", "is_adj", "find walk",
+            "degree", "full pass");
+
+    for (uint32_t s = 0; s < sizeof(sizes)/sizeof(sizes[0]); ++s) {
+        uint32_t n = sizes[s];
+        if (n > MAX_NEIGHBORS) {
+            continue;
+        }
+
+        bench_scene(n, n);
+        bench_hear(0);
+        localize_all(&state, LOC_MAX_REFS);
+
+        // per pair, per row walked and per row counted
+        n = state.nbi->n_nbrs;
+        printf("%8u %8.1fns %10.1fns %8.1fns %10.2fus\n", n,
+                bench_time(_run_is_adj, NULL, n*n),
+                bench_time(_run_find, NULL, n),
+                bench_time(_run_degree, NULL, n),
+                1e-3 * bench_time(_run_full, NULL, 1));
+    }
+}
@@ -0,0 +1,70 @@
+/*! file: bench_compact.c
+ *
+ * Expiry with compaction: fill a neighborhood, let three quarters of
+ * it go quiet until it times out, and compare the table and the cost of
+ * a full localization pass before and after
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+
+#include "constants.h"
+#include "state.h"
+#include "nbi.h"
+#include "localize.h"
+
+static void
+_run_full(void *ctx)
+{
+    (void)ctx;
+    bench_localize_full();
+}
+
+void
+bench_compact(void)
+{
+    static const uint32_t sizes[][2] = { { 14, 4 }, { 32, 8 }, { 64, 16 } };
+
+    printf("%8s %8s %12s %12s %12s\n", "before", "after", "expire",
+            "pass before", "pass after");
+
+    for (uint32_t s = 0; s < sizeof(sizes)/sizeof(sizes[0]); ++s) {
+        uint32_t n = sizes[s][0];
+        uint32_t keep = sizes[s][1];
+        if (n > MAX_NEIGHBORS) {
+            continue;
+        }
+
+        bench_scene(n, n);
+        bench_hear(0);
+        localize_all(&state, LOC_MAX_REFS);
+        uint32_t before = state.nbi->n_nbrs;
+        double pass_before = bench_time(_run_full, NULL, 1);
+
+        // only every few robots keeps talking, spread over the table so
+        // expiry has to move neighbors down into the freed slots
+        for (uint32_t k = 1; k <= keep; ++k) {
+            bench_robots[k] = bench_robots[k * (n / keep)];
+        }
+        bench_n_robots = keep + 1;
+
+        double expire = 0.0;
+        for (uint32_t t = 0; t < NEIGHBOR_TIMEOUT_TICKS + 2*NBI_WHEEL_WIDTH;
+                ++t) {
+            bench_tick();
+            bench_hear(0);
+
+            double t0 = bench_now();
+            nbi_expire_nbrs(state.nbi, state.ticks);
+            if (state.nbi->n_expired) {
+                expire += bench_now() - t0;
+            }
+        }
+        localize_all(&state, LOC_MAX_REFS);
+
+        printf("%8u %8u %10.2fus %10.2fus %10.2fus\n", before,
+                state.nbi->n_nbrs, 1e6 * expire, 1e-3 * pass_before,
+                1e-3 * bench_time(_run_full, NULL, 1));
+    }
+}
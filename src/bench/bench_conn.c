@@ -0,0 +1,160 @@
+/*! file: bench_conn.c
+ *
+ * Connectivity queries: nbi_is_connected (frontier search over
+ * adjacency words) against the adjacency matrix powers it replaced,
+ * run on a bitmat copy of the same adjacency. Each slot is asked about
+ * the slot halfway round the table, on a chain (sparse, long paths)
+ * and on a random graph with half the links present (dense, short
+ * paths).
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "constants.h"
+#include "state.h"
+#include "nbi.h"
+#include "bitarray.h"
+
+/*! conn_ctx_t
+ *
+ * The graph under test
+ */
+typedef struct conn_ctx_t {
+    uint32_t n;
+    bitmat_t adj;
+    uint8_t adj_data[STATIC_SIZE_NBI_ADJ_DATA];
+} conn_ctx_t;
+
+/*! _powers_connected
+ *
+ * Connectivity as it was before the frontier search
+ */
+static bool
+_powers_connected(
+    conn_ctx_t *ctx,
+    uint32_t i,
+    uint32_t j)
+{
+    uint8_t _acc_raw[STATIC_SIZE_NBI_ADJ_DATA];
+    uint8_t _next_raw[STATIC_SIZE_NBI_ADJ_DATA];
+
+    if (bm_is_set(&ctx->adj, i, j)) {
+        return true;
+    }
+
+    bitmat_t acc;
+    bm_init(&acc, ctx->adj.n, 0, BM_SYMMETRIC,
+            _acc_raw, STATIC_SIZE_NBI_ADJ_DATA);
+    bm_copy(&acc, &ctx->adj);
+
+    bitmat_t next;
+    bm_init(&next, ctx->adj.n, 0, BM_SYMMETRIC,
+            _next_raw, STATIC_SIZE_NBI_ADJ_DATA);
+
+    for (uint32_t k = 0; k < ctx->n; ++k) {
+        bm_mult(&acc, &ctx->adj, &next);
+        bm_copy(&acc, &next);
+        if (bm_is_set(&acc, i, j)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void
+_run_powers(void *ctx)
+{
+    conn_ctx_t *c = (conn_ctx_t*)ctx;
+    volatile uint32_t sink = 0;
+    for (uint32_t i = 0; i < c->n; ++i) {
+        sink += _powers_connected(c, i, (i + c->n/2) % c->n);
+    }
+    (void)sink;
+}
+
+static void
+_run_frontier(void *ctx)
+{
+    conn_ctx_t *c = (conn_ctx_t*)ctx;
+    volatile uint32_t sink = 0;
+    for (uint32_t i = 0; i < c->n; ++i) {
+        sink += nbi_is_connected(state.nbi, i, (i + c->n/2) % c->n);
+    }
+    (void)sink;
+}
+
+/*! _conn_graph
+ *
+ * Fill the table with n neighbors linked as a chain, or at random with
+ * half the links present, and copy the adjacency into ctx
+ */
+static void
+_conn_graph(
+    conn_ctx_t *ctx,
+    uint32_t n,
+    bool chain)
+{
+    srand(n);
+    bench_reset();
+
+    for (uint32_t k = 0; k < n; ++k) {
+        nbi_update_id(state.nbi, (kb_id_t)(0x200 + k), state.ticks);
+    }
+    for (uint32_t i = 0; i < n; ++i) {
+        for (uint32_t j = i + 1; j < n; ++j) {
+            if (chain? j == i + 1 : (rand() & 0x1)) {
+                nbi_set_adj(state.nbi, i, j);
+            }
+        }
+    }
+
+    ctx->n = n;
+    bm_init(&ctx->adj, MAX_NEIGHBORS, 0, BM_SYMMETRIC,
+            ctx->adj_data, STATIC_SIZE_NBI_ADJ_DATA);
+    for (uint32_t i = 0; i < n; ++i) {
+        for (uint32_t j = i + 1; j < n; ++j) {
+            if (nbi_is_adj(state.nbi, i, j)) {
+                bm_set(&ctx->adj, i, j);
+            }
+        }
+    }
+}
+
+void
+bench_conn(void)
+{
+    static const uint32_t sizes[] = { 16, 32, 64 };
+    static conn_ctx_t ctx;
+
+    printf("%8s %8s %12s %12s\n", "nbrs", "graph", "powers", "frontier");
+
+    for (uint32_t s = 0; s < sizeof(sizes)/sizeof(sizes[0]); ++s) {
+        uint32_t n = sizes[s];
+        if (n > MAX_NEIGHBORS) {
+            continue;
+        }
+
+        for (uint32_t g = 0; g < 2; ++g) {
+            bool chain = (g == 0);
+            _conn_graph(&ctx, n, chain);
+
+            // both have to agree before either is timed
+            for (uint32_t i = 0; i < n; ++i) {
+                uint32_t j = (i + n/2) % n;
+                if (_powers_connected(&ctx, i, j)
+                        != nbi_is_connected(state.nbi, i, j)) {
+                    printf("%8u connectivity mismatch on %u-%u\n", n, i, j);
+                    return;
+                }
+            }
+
+            printf("%8u %8s %10.0fns %10.1fns\n", n,
+                    chain? "chain" : "random",
+                    bench_time(_run_powers, &ctx, n),
+                    bench_time(_run_frontier, &ctx, n));
+        }
+    }
+}
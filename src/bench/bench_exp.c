@@ -0,0 +1,198 @@
+/*! file: bench_exp.c
+ *
+ * Localization on the layouts of the exp/test_localize_*.argos
+ * experiments, rebuilt here the way their <distribute> blocks place
+ * robots (non-overlapping, fixed seed). Each layout is run from the
+ * point of view of a number of its robots: a round of messages with
+ * +-2 distance noise every tick, then a pass if one is due.
+ *
+ * Built with LOC_STATS (cmake -DKB_LOC_STATS=ON) this also prints what
+ * the passes did: rounds per pass, neighbors tried, NaN fallbacks in
+ * trilateration, NaN triangulations (range triples that don't make a
+ * triangle), residual fallbacks and multilateration fits, summed over
+ * every run.
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "constants.h"
+#include "state.h"
+#include "nbi.h"
+#include "localize.h"
+#include "mask.h"
+
+#define EXP_MAX_ROBOTS  500
+#define EXP_OBSERVERS   50
+#define EXP_TICKS       100
+#define EXP_NOISE       2
+// body diameter, distribute won't place two robots closer than this
+#define EXP_BODY        33.0f
+
+/*! exp_layout_t
+ *
+ * An experiment layout, all lengths in mm
+ */
+typedef struct exp_layout_t {
+    const char *name;
+    uint32_t n;
+    // grid: columns, rows and spacing
+    uint32_t cols, rows;
+    float spacing;
+    // random: uniform half width or gaussian std dev
+    float uniform, gauss;
+    // explicit positions
+    const float (*at)[2];
+} exp_layout_t;
+
+static const float _exp_2[][2] = { {0, 0}, {100, 0} };
+static const float _exp_4[][2] = { {0, 0}, {50, 0}, {0, 50}, {50, 50} };
+static const float _exp_5[][2] = {
+    {0, 0}, {50, 0}, {0, 50}, {-50, 0}, {0, -50}
+};
+
+static const exp_layout_t _exp_layouts[] = {
+    { "2",          2,   0,  0,  0.0f,   0.0f,   0.0f, _exp_2 },
+    { "4",          4,   0,  0,  0.0f,   0.0f,   0.0f, _exp_4 },
+    { "5",          5,   0,  0,  0.0f,   0.0f,   0.0f, _exp_5 },
+    { "grid",       9,   3,  3, 50.0f,   0.0f,   0.0f, NULL },
+    { "grid_large", 100, 10, 10, 50.0f,  0.0f,   0.0f, NULL },
+    { "rand",       500, 0,  0,  0.0f, 500.0f,   0.0f, NULL },
+    { "gauss",      500, 0,  0,  0.0f,   0.0f, 220.0f, NULL },
+};
+
+#define N_EXP_LAYOUTS   (sizeof(_exp_layouts)/sizeof(_exp_layouts[0]))
+
+/*! _exp_gauss
+ *
+ * Standard normal sample
+ */
+static float
+_exp_gauss(void)
+{
+    float u = (rand() + 1.0f) / (RAND_MAX + 2.0f);
+    float v = (float)rand() / RAND_MAX;
+    return sqrtf(-2.0f * logf(u)) * cosf(2.0f * (float)M_PI * v);
+}
+
+/*! _exp_place
+ *
+ * Lay out the robots of l in pos, the way distribute would
+ *
+ * Returns how many were placed
+ */
+static uint32_t
+_exp_place(
+    const exp_layout_t *l,
+    point_t *pos)
+{
+    uint32_t n = 0;
+
+    if (l->at) {
+        for (n = 0; n < l->n; ++n) {
+            pos[n].x = l->at[n][0];
+            pos[n].y = l->at[n][1];
+        }
+        return n;
+    }
+
+    if (l->cols) {
+        for (uint32_t r = 0; r < l->rows; ++r) {
+            for (uint32_t c = 0; c < l->cols; ++c) {
+                pos[n].x = l->spacing * (c - 0.5f * (l->cols - 1));
+                pos[n].y = l->spacing * (r - 0.5f * (l->rows - 1));
+                ++n;
+            }
+        }
+        return n;
+    }
+
+    // random placements get retried while they'd overlap someone
+    srand(l->n);
+    for (uint32_t k = 0; k < l->n; ++k) {
+        for (uint32_t tries = 0; tries < 200; ++tries) {
+            point_t p;
+            if (l->gauss > 0.0f) {
+                p.x = l->gauss * _exp_gauss();
+                p.y = l->gauss * _exp_gauss();
+            } else {
+                p.x = l->uniform * (2.0f * rand() / RAND_MAX - 1.0f);
+                p.y = l->uniform * (2.0f * rand() / RAND_MAX - 1.0f);
+            }
+
+            bool overlap = false;
+            for (uint32_t j = 0; j < n && !overlap; ++j) {
+                overlap = hypotf(p.x - pos[j].x, p.y - pos[j].y) < EXP_BODY;
+            }
+            if (!overlap) {
+                pos[n++] = p;
+                break;
+            }
+        }
+    }
+    return n;
+}
+
+void
+bench_exp(void)
+{
+    static point_t pos[EXP_MAX_ROBOTS];
+
+#ifdef LOC_STATS
+    printf("%10s %6s %6s %8s %8s %10s %8s %8s %8s %8s %10s\n", "layout",
+            "robots", "runs", "passes", "rounds", "attempts", "nan",
+            "nan tri", "resid", "fits", "localized");
+#else
+    printf("%10s %6s %6s %10s %12s\n", "layout", "robots", "runs",
+            "localized", "per tick");
+    printf("(build with KB_LOC_STATS for pass counts)\n");
+#endif
+
+    for (uint32_t l = 0; l < N_EXP_LAYOUTS; ++l) {
+        uint32_t n = _exp_place(&_exp_layouts[l], pos);
+        uint32_t stride = (n + EXP_OBSERVERS - 1) / EXP_OBSERVERS;
+
+#ifdef LOC_STATS
+        localize_stats_t before = localize_stats;
+#endif
+        uint32_t runs = 0;
+        uint32_t localized = 0;
+        uint32_t nbrs = 0;
+        double t = 0.0;
+        for (uint32_t us = 0; us < n; us += stride) {
+            bench_scene_at(pos, n, us);
+            srand(us);
+            for (uint32_t k = 0; k < EXP_TICKS; ++k) {
+                bench_tick();
+                bench_hear(EXP_NOISE);
+                double t0 = bench_now();
+                localize_all(&state, LOC_MAX_REFS);
+                t += bench_now() - t0;
+            }
+
+            nbrs_info_t *nbi = state.nbi;
+            localized += mask_count(nbi_get_flag_mask(nbi, NBR_LOCALIZED));
+            nbrs += nbi->n_nbrs;
+            ++runs;
+        }
+
+#ifdef LOC_STATS
+        localize_stats_t *s = &localize_stats;
+        uint32_t passes = s->passes - before.passes;
+        printf("%10s %6u %6u %8u %8.2f %10u %8u %8u %8u %8u %5u/%-4u\n",
+                _exp_layouts[l].name, n, runs, passes,
+                passes? (double)(s->rounds - before.rounds) / passes : 0.0,
+                s->attempts - before.attempts,
+                s->nan_fallbacks - before.nan_fallbacks,
+                s->nan_drops - before.nan_drops,
+                s->resid_fallbacks - before.resid_fallbacks,
+                s->fits - before.fits, localized, nbrs);
+#else
+        printf("%10s %6u %6u %5u/%-4u %10.2fus\n", _exp_layouts[l].name,
+                n, runs, localized, nbrs, 1e6 * t / (runs * EXP_TICKS));
+#endif
+    }
+}
@@ -0,0 +1,174 @@
+/*! file: bench_fastmath.c
+ *
+ * kb_fastmath against the libm float functions it stands in for: the
+ * worst absolute error of each over a dense sweep, measured against
+ * double libm, and ns per call over a table of inputs. Built without
+ * KB_FASTMATH both columns are libm.
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "constants.h"
+#include "kb_fastmath.h"
+
+#define FM_SWEEP    1000000
+#define FM_INPUTS   1024
+
+/*! fm_ctx_t
+ *
+ * Inputs for the throughput runs
+ */
+typedef struct fm_ctx_t {
+    float x[FM_INPUTS];
+    float y[FM_INPUTS];
+} fm_ctx_t;
+
+static void
+_run_kb_atan2(void *ctx)
+{
+    fm_ctx_t *c = (fm_ctx_t*)ctx;
+    volatile float sink = 0.0f;
+    for (uint32_t k = 0; k < FM_INPUTS; ++k) {
+        sink += kb_atan2(c->y[k], c->x[k]);
+    }
+    (void)sink;
+}
+
+static void
+_run_atan2f(void *ctx)
+{
+    fm_ctx_t *c = (fm_ctx_t*)ctx;
+    volatile float sink = 0.0f;
+    for (uint32_t k = 0; k < FM_INPUTS; ++k) {
+        sink += atan2f(c->y[k], c->x[k]);
+    }
+    (void)sink;
+}
+
+static void
+_run_kb_sincos(void *ctx)
+{
+    fm_ctx_t *c = (fm_ctx_t*)ctx;
+    volatile float sink = 0.0f;
+    for (uint32_t k = 0; k < FM_INPUTS; ++k) {
+        float s, co;
+        kb_sincos(c->x[k], &s, &co);
+        sink += s + co;
+    }
+    (void)sink;
+}
+
+static void
+_run_sincosf(void *ctx)
+{
+    fm_ctx_t *c = (fm_ctx_t*)ctx;
+    volatile float sink = 0.0f;
+    for (uint32_t k = 0; k < FM_INPUTS; ++k) {
+        sink += sinf(c->x[k]) + cosf(c->x[k]);
+    }
+    (void)sink;
+}
+
+static void
+_run_kb_acos(void *ctx)
+{
+    fm_ctx_t *c = (fm_ctx_t*)ctx;
+    volatile float sink = 0.0f;
+    for (uint32_t k = 0; k < FM_INPUTS; ++k) {
+        sink += kb_acos(c->y[k]);
+    }
+    (void)sink;
+}
+
+static void
+_run_acosf(void *ctx)
+{
+    fm_ctx_t *c = (fm_ctx_t*)ctx;
+    volatile float sink = 0.0f;
+    for (uint32_t k = 0; k < FM_INPUTS; ++k) {
+        sink += acosf(c->y[k]);
+    }
+    (void)sink;
+}
+
+/*! _fm_err
+ *
+ * Fold the error of got against want into the worst so far
+ */
+static void
+_fm_err(
+    double *worst,
+    float got,
+    double want)
+{
+    double e = fabs((double)got - want);
+    if (e > *worst) {
+        *worst = e;
+    }
+}
+
+void
+bench_fastmath(void)
+{
+    static fm_ctx_t ctx;
+
+#ifndef KB_FASTMATH
+    printf("built without KB_FASTMATH, kb_* are libm\n");
+#endif
+
+    // atan2 all the way round, at a few radii
+    double e_atan2 = 0.0, e_atan2f = 0.0;
+    for (uint32_t k = 0; k < FM_SWEEP; ++k) {
+        double a = -PI + 2.0 * PI * k / FM_SWEEP;
+        double r = 1.0 + 99.0 * (k % 7) / 6.0;
+        float y = (float)(r * sin(a));
+        float x = (float)(r * cos(a));
+        _fm_err(&e_atan2, kb_atan2(y, x), atan2(y, x));
+        _fm_err(&e_atan2f, atan2f(y, x), atan2(y, x));
+    }
+
+    // sincos over the range odometry headings get to
+    double e_sincos = 0.0, e_sincosf = 0.0;
+    for (uint32_t k = 0; k < FM_SWEEP; ++k) {
+        float t = (float)(-64.0 * PI + 128.0 * PI * k / FM_SWEEP);
+        float s, c;
+        kb_sincos(t, &s, &c);
+        _fm_err(&e_sincos, s, sin(t));
+        _fm_err(&e_sincos, c, cos(t));
+        _fm_err(&e_sincosf, sinf(t), sin(t));
+        _fm_err(&e_sincosf, cosf(t), cos(t));
+    }
+
+    // acos over its domain, ends included
+    double e_acos = 0.0, e_acosf = 0.0;
+    for (uint32_t k = 0; k <= FM_SWEEP; ++k) {
+        float x = (float)(-1.0 + 2.0 * k / FM_SWEEP);
+        _fm_err(&e_acos, kb_acos(x), acos(x));
+        _fm_err(&e_acosf, acosf(x), acos(x));
+    }
+
+    srand(FM_INPUTS);
+    for (uint32_t k = 0; k < FM_INPUTS; ++k) {
+        ctx.x[k] = 200.0f * rand() / RAND_MAX - 100.0f;
+        ctx.y[k] = 2.0f * rand() / RAND_MAX - 1.0f;
+    }
+
+    printf("%8s %10s %10s %10s %10s\n", "", "kb err", "libm err",
+            "kb", "libm");
+    printf("%8s %10.2g %10.2g %8.1fns %8.1fns\n", "atan2",
+            e_atan2, e_atan2f,
+            bench_time(_run_kb_atan2, &ctx, FM_INPUTS),
+            bench_time(_run_atan2f, &ctx, FM_INPUTS));
+    printf("%8s %10.2g %10.2g %8.1fns %8.1fns\n", "sincos",
+            e_sincos, e_sincosf,
+            bench_time(_run_kb_sincos, &ctx, FM_INPUTS),
+            bench_time(_run_sincosf, &ctx, FM_INPUTS));
+    printf("%8s %10.2g %10.2g %8.1fns %8.1fns\n", "acos",
+            e_acos, e_acosf,
+            bench_time(_run_kb_acos, &ctx, FM_INPUTS),
+            bench_time(_run_acosf, &ctx, FM_INPUTS));
+}
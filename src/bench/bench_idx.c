@@ -0,0 +1,107 @@
+/*! file: bench_idx.c
+ *
+ * Neighbor lookup by id: nbi_get_nbr_idx through the id index against
+ * the linear scan over the table it replaced, for ids that are in the
+ * table and ids that aren't
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "constants.h"
+#include "state.h"
+#include "nbi.h"
+
+#include <kilolib.h>
+
+#define IDX_ROUNDS  200000
+
+/*! _scan_idx
+ *
+ * Lookup as it was before the id index
+ */
+static uint32_t
+_scan_idx(
+    nbrs_info_t *nbi,
+    kb_id_t id)
+{
+    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
+        if (NBI_NBR_ID(nbi, i) == id) {
+            return i;
+        }
+    }
+    return INVALID_INDEX;
+}
+
+/*! _time_lookups
+ *
+ * ns per lookup of every id in ids, called through a pointer so
+ * neither lookup can be inlined into the loop
+ */
+static double
+_time_lookups(
+    uint32_t (*volatile find)(nbrs_info_t*, kb_id_t),
+    const kb_id_t *ids,
+    uint32_t n)
+{
+    volatile uint32_t sink = 0;
+    double t0 = bench_now();
+    for (uint32_t r = 0; r < IDX_ROUNDS; ++r) {
+        for (uint32_t k = 0; k < n; ++k) {
+            sink += find(state.nbi, ids[k]);
+        }
+    }
+    (void)sink;
+    return 1e9 * (bench_now() - t0) / ((double)IDX_ROUNDS * n);
+}
+
+void
+bench_idx(void)
+{
+    static const uint32_t sizes[] = { 16, 32, 64 };
+
+    printf("%8s %10s %10s %10s %10s\n", "nbrs", "scan hit", "idx hit",
+            "scan miss", "idx miss");
+
+    for (uint32_t s = 0; s < sizeof(sizes)/sizeof(sizes[0]); ++s) {
+        uint32_t n = sizes[s];
+        if (n > MAX_NEIGHBORS) {
+            continue;
+        }
+
+        // random distinct ids, the first n in the table
+        srand(n);
+        bench_reset();
+        kb_id_t ids[2*64];
+        for (uint32_t k = 0; k < 2*n; ) {
+            kb_id_t id = (kb_id_t)(rand() & 0xffff);
+            bool dup = (id == KB_ID_INVALID || id == kilo_uid);
+            for (uint32_t j = 0; j < k && !dup; ++j) {
+                dup = (ids[j] == id);
+            }
+            if (!dup) {
+                ids[k++] = id;
+            }
+        }
+        for (uint32_t k = 0; k < n; ++k) {
+            nbi_update_id(state.nbi, ids[k], state.ticks);
+        }
+
+        // both have to agree before either is timed
+        for (uint32_t k = 0; k < 2*n; ++k) {
+            if (_scan_idx(state.nbi, ids[k])
+                    != nbi_get_nbr_idx(state.nbi, ids[k])) {
+                printf("%8u lookup mismatch on 0x%x\n", n, ids[k]);
+                return;
+            }
+        }
+
+        printf("%8u %8.1fns %8.1fns %8.1fns %8.1fns\n", n,
+                _time_lookups(_scan_idx, ids, n),
+                _time_lookups(nbi_get_nbr_idx, ids, n),
+                _time_lookups(_scan_idx, ids + n, n),
+                _time_lookups(nbi_get_nbr_idx, ids + n, n));
+    }
+}
@@ -0,0 +1,47 @@
+/*! file: bench_loc.c
+ *
+ * Cost of a full localization pass against the number of neighbors,
+ * up to the configured capacity
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+
+#include "constants.h"
+#include "state.h"
+#include "nbi.h"
+#include "localize.h"
+#include "mask.h"
+
+static void
+_run_full(void *ctx)
+{
+    (void)ctx;
+    bench_localize_full();
+}
+
+void
+bench_loc(void)
+{
+    static const uint32_t sizes[] = { 8, 16, 32, 64 };
+
+    printf("%8s %10s %8s %12s\n", "nbrs", "localized", "comps", "full pass");
+
+    for (uint32_t s = 0; s < sizeof(sizes)/sizeof(sizes[0]); ++s) {
+        uint32_t n = sizes[s];
+        if (n > MAX_NEIGHBORS) {
+            continue;
+        }
+
+        bench_scene(n, n);
+        bench_hear(0);
+        localize_all(&state, LOC_MAX_REFS);
+
+        nbrs_info_t *nbi = state.nbi;
+        double ns = bench_time(_run_full, NULL, 1);
+        printf("%8u %10u %8u %10.2fus\n", nbi->n_nbrs,
+                mask_count(nbi_get_flag_mask(nbi, NBR_LOCALIZED)),
+                nbi->n_comps, 1e-3 * ns);
+    }
+}
@@ -0,0 +1,105 @@
+/*! file: bench_loctick.c
+ *
+ * Per-tick localization cost in a static neighborhood of 16 with +-2
+ * distance noise, the way the loop sees it: every tick a round of
+ * messages, then a pass if one is due. Incremental passes (localize_all
+ * as it is) against redoing everyone whenever a pass is due, which is
+ * what every pass did before locations were kept. "passes" is the
+ * share of ticks a pass was due; worst is the slowest single tick.
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "constants.h"
+#include "state.h"
+#include "nbi.h"
+#include "localize.h"
+#include "mask.h"
+
+#define LOCTICK_NBRS    16
+#define LOCTICK_NOISE   2
+#define LOCTICK_TICKS   5000
+#define LOCTICK_WARMUP  50
+
+/*! _loctick_due
+ *
+ * Whether localize_all would run a pass now
+ */
+static bool
+_loctick_due(nbrs_info_t *nbi)
+{
+    return nbi->n_nbrs > 0 && nbi->n_comps < NBI_MAX_COMPS
+        && (!nbi_is_localized(nbi)
+            || nbi_get_gen(nbi) != nbi->localized_gen
+            || nbi->loc_dirty != MASK_NONE);
+}
+
+/*! _loctick_run
+ *
+ * Run the scene from seed for LOCTICK_TICKS ticks, passing full or
+ * incremental, and print us per tick, how often a pass ran and the
+ * slowest one
+ */
+static void
+_loctick_run(
+    uint32_t seed,
+    bool full)
+{
+    bench_scene(LOCTICK_NBRS, seed);
+    srand(seed);
+    for (uint32_t t = 0; t < LOCTICK_WARMUP; ++t) {
+        bench_tick();
+        bench_hear(LOCTICK_NOISE);
+        localize_all(&state, LOC_MAX_REFS);
+    }
+
+    nbrs_info_t *nbi = state.nbi;
+    uint32_t passes = 0;
+    double total = 0.0;
+    double worst = 0.0;
+    for (uint32_t t = 0; t < LOCTICK_TICKS; ++t) {
+        bench_tick();
+        bench_hear(LOCTICK_NOISE);
+
+        bool due = _loctick_due(nbi);
+        double t0 = bench_now();
+        if (!full) {
+            localize_all(&state, LOC_MAX_REFS);
+        } else if (due) {
+            bench_localize_full();
+        }
+        double dt = bench_now() - t0;
+
+        total += dt;
+        passes += due;
+        if (dt > worst) {
+            worst = dt;
+        }
+    }
+
+    printf("%8u %12s %10.2fus %9.1f%% %10.2fus %10u\n", seed,
+            full? "full" : "incremental",
+            1e6 * total / LOCTICK_TICKS, 100.0 * passes / LOCTICK_TICKS,
+            1e6 * worst,
+            mask_count(nbi_get_flag_mask(nbi, NBR_LOCALIZED)));
+}
+
+void
+bench_loctick(void)
+{
+    if (LOCTICK_NBRS > MAX_NEIGHBORS) {
+        printf("needs MAX_NEIGHBORS >= %u\n", LOCTICK_NBRS);
+        return;
+    }
+
+    printf("%8s %12s %12s %10s %12s %10s\n", "seed", "pass", "per tick",
+            "passes", "worst", "localized");
+
+    for (uint32_t seed = 1; seed <= 3; ++seed) {
+        _loctick_run(seed, true);
+        _loctick_run(seed, false);
+    }
+}
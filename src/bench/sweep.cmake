@@ -0,0 +1,47 @@
+#
+# kbbench at every capacity in KB_BENCH_CAPACITIES, run by the
+# kbbench_sweep target as
+#
+#   cmake -DBUILD=<build dir> -DBENCH=<kbbench dir> -P sweep.cmake
+#
+# Each capacity gets its own build tree under BUILD/kbbench_sweep,
+# configured like BUILD except for KB_MAX_NEIGHBORS, and kbbench is
+# run there with the KB_BENCH_SWEEP benches.
+#
+load_cache(${BUILD} READ_WITH_PREFIX ""
+  CMAKE_HOME_DIRECTORY CMAKE_BUILD_TYPE
+  KB_BENCH_CAPACITIES KB_BENCH_SWEEP
+  KB_NBI_SOA KB_NBI_ADJ_BITMAT KB_NBI_DIST_EMA KB_NBI_DIST_AGE
+  KB_LOC_STATS KB_FASTMATH)
+
+set(opts -DCMAKE_BUILD_TYPE=${CMAKE_BUILD_TYPE})
+foreach(opt KB_NBI_SOA KB_NBI_ADJ_BITMAT KB_NBI_DIST_EMA KB_NBI_DIST_AGE
+    KB_LOC_STATS KB_FASTMATH)
+  list(APPEND opts -D${opt}=${${opt}})
+endforeach(opt)
+
+file(RELATIVE_PATH bench_rel ${BUILD} ${BENCH})
+
+foreach(cap ${KB_BENCH_CAPACITIES})
+  set(dir ${BUILD}/kbbench_sweep/${cap})
+  message("== MAX_NEIGHBORS=${cap}")
+
+  execute_process(COMMAND ${CMAKE_COMMAND} -S ${CMAKE_HOME_DIRECTORY}
+      -B ${dir} -DKB_MAX_NEIGHBORS=${cap} ${opts}
+    OUTPUT_QUIET RESULT_VARIABLE rc)
+  if(rc)
+    message(FATAL_ERROR "configuring ${dir} failed")
+  endif(rc)
+
+  execute_process(COMMAND ${CMAKE_COMMAND} --build ${dir} --target kbbench
+    OUTPUT_QUIET RESULT_VARIABLE rc)
+  if(rc)
+    message(FATAL_ERROR "building kbbench in ${dir} failed")
+  endif(rc)
+
+  execute_process(COMMAND ${dir}/${bench_rel}/kbbench ${KB_BENCH_SWEEP}
+    RESULT_VARIABLE rc)
+  if(rc)
+    message(FATAL_ERROR "kbbench at MAX_NEIGHBORS=${cap} failed")
+  endif(rc)
+endforeach(cap)
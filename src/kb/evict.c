@@ -0,0 +1,254 @@
+#include "evict.h"
+
+#include "constants.h"
+#include "mask.h"
+#include "nbi.h"
+#include "nbr.h"
+
+#include "err.h"
+
+/*! _evict_better
+ *
+ * Static helper to compare two candidates. Lower score wins, ties go
+ * to whoever we heard from longest ago.
+ */
+static bool
+_evict_better(
+    nbrs_info_t *nbi,
+    uint32_t score, uint32_t i,
+    uint32_t best_score, uint32_t best)
+{
+    if (best == INVALID_INDEX || score < best_score) {
+        return true;
+    }
+    return score == best_score
+        && NBI_NBR_LAST_TIME(nbi, i) < NBI_NBR_LAST_TIME(nbi, best);
+}
+
+/*! _evict_oldest
+ *
+ * Evict the neighbor we heard from longest ago
+ */
+static uint32_t
+_evict_oldest(
+    nbrs_info_t *nbi,
+    void *ctx)
+{
+    (void)ctx;
+
+    uint32_t idx = INVALID_INDEX;
+    kb_time_t oldest = (kb_time_t)-1;
+    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
+        if (NBI_NBR_LAST_TIME(nbi, i) < oldest) {
+            oldest = NBI_NBR_LAST_TIME(nbi, i);
+            idx = i;
+        }
+    }
+
+    return idx;
+}
+
+/*! _evict_farthest
+ *
+ * Evict the neighbor farthest from us. Neighbors we have no range to
+ * yet count as farthest.
+ */
+static uint32_t
+_evict_farthest(
+    nbrs_info_t *nbi,
+    void *ctx)
+{
+    (void)ctx;
+
+    uint32_t idx = INVALID_INDEX;
+    uint32_t best = 0;
+    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
+        // score is inverted so that farther is lower
+        uint32_t score = KB_DIST_INVALID - nbi_get_dist(nbi, i, i);
+        if (_evict_better(nbi, score, i, best, idx)) {
+            best = score;
+            idx = i;
+        }
+    }
+
+    return idx;
+}
+
+/*! _evict_fewest_links
+ *
+ * Evict the neighbor with the fewest adjacency links to the rest of
+ * the neighborhood
+ */
+static uint32_t
+_evict_fewest_links(
+    nbrs_info_t *nbi,
+    void *ctx)
+{
+    (void)ctx;
+
+    uint32_t idx = INVALID_INDEX;
+    uint32_t best = 0;
+    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
+        uint32_t score = nbi_get_degree(nbi, i);
+        if (_evict_better(nbi, score, i, best, idx)) {
+            best = score;
+            idx = i;
+        }
+    }
+
+    return idx;
+}
+
+/*! _evict_fewest_refs
+ *
+ * Evict the neighbor that the fewest localized neighbors were placed
+ * from. Everything localized in a component ultimately hangs off its
+ * anchor, so the anchor counts as a reference for all of them.
+ *
+ * ctx is scratch space for the per-slot reference counts.
+ */
+static uint32_t
+_evict_fewest_refs(
+    nbrs_info_t *nbi,
+    void *ctx)
+{
+    uint8_t *refs = (uint8_t*)ctx;
+    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
+        refs[i] = 0;
+    }
+
+    // count how many localized neighbors each slot was a reference for
+    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
+        if (!nbi_nbr_is_localized(nbi, i)) continue;
+
+        nbr_t *n = nbi_get_nbr(nbi, i);
+        for (uint32_t r = 0; r < 2; ++r) {
+            if (n->refs[r] < nbi->n_nbrs) {
+                ++refs[n->refs[r]];
+            }
+        }
+        if (n->comp && n->comp->anchor && n->comp->anchor != n) {
+            ++refs[n->comp->anchor->idx];
+        }
+    }
+
+    uint32_t idx = INVALID_INDEX;
+    uint32_t best = 0;
+    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
+        uint32_t score = refs[i];
+        if (_evict_better(nbi, score, i, best, idx)) {
+            best = score;
+            idx = i;
+        }
+    }
+
+    return idx;
+}
+
+/*! _evict_stalest
+ *
+ * Evict the neighbor whose freshest distance to anyone else in the
+ * neighborhood is the oldest, they're the least use as a reference.
+ * Neighbors with no distances at all count as stalest. Built without
+ * NBI_DIST_AGE every distance is fresh, so this only picks out those.
+ */
+static uint32_t
+_evict_stalest(
+    nbrs_info_t *nbi,
+    void *ctx)
+{
+    (void)ctx;
+
+    uint32_t idx = INVALID_INDEX;
+    uint32_t best = 0;
+    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
+        uint16_t fresh = NBI_DIST_AGE_INVALID;
+        for (uint32_t j = 0; j < nbi->n_nbrs; ++j) {
+            if (j == i) continue;
+            uint16_t age = nbi_get_dist_age(nbi, i, j);
+            if (age < fresh) {
+                fresh = age;
+            }
+        }
+
+        // score is inverted so that staler is lower
+        uint32_t score = NBI_DIST_AGE_INVALID - fresh;
+        if (_evict_better(nbi, score, i, best, idx)) {
+            best = score;
+            idx = i;
+        }
+    }
+
+    return idx;
+}
+
+//
+// Static policy table, indexed by policy
+//
+static uint8_t _evict_refs_ctx[MAX_NEIGHBORS];
+
+static evict_pol_t _evict_pols[EVICT_N_POLS] = {
+    [POL_EVICT_OLDEST]       = {"evict_oldest", _evict_oldest, NULL},
+    [POL_EVICT_FARTHEST]     = {"evict_farthest", _evict_farthest, NULL},
+    [POL_EVICT_FEWEST_LINKS] = {"evict_fewest_links",
+                                _evict_fewest_links, NULL},
+    [POL_EVICT_FEWEST_REFS]  = {"evict_fewest_refs",
+                                _evict_fewest_refs, _evict_refs_ctx},
+    [POL_EVICT_STALEST]      = {"evict_stalest", _evict_stalest, NULL},
+};
+
+/*! evict_register
+ *
+ * Add or replace a policy in the table
+ *
+ * @return true if the policy was registered
+ */
+bool
+evict_register(
+    uint8_t pol,
+    const char *name,
+    evict_func_t *pick,
+    void *ctx)
+{
+    ASSERT_OR_ERR(pol < EVICT_N_POLS && name && pick, err, KB_ERR_INPUT);
+
+    _evict_pols[pol].name = name;
+    _evict_pols[pol].pick = pick;
+    _evict_pols[pol].ctx = ctx;
+
+    return true;
+err:
+    return false;
+}
+
+/*! evict_get_pol
+ *
+ * Look up a policy, NULL if there is none registered
+ */
+evict_pol_t *
+evict_get_pol(uint8_t pol)
+{
+    if (pol >= EVICT_N_POLS || !_evict_pols[pol].pick) {
+        return NULL;
+    }
+    return &_evict_pols[pol];
+}
+
+/*! evict_pick
+ *
+ * Ask a policy which slot of a full table to evict
+ */
+uint32_t
+evict_pick(
+    nbrs_info_t *nbi,
+    uint8_t pol)
+{
+    ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
+
+    evict_pol_t *p = evict_get_pol(pol);
+    ASSERT_OR_ERR(p, err, KB_ERR_INPUT);
+
+    return p->pick(nbi, p->ctx);
+err:
+    return INVALID_INDEX;
+}
@@ -0,0 +1,59 @@
+#ifndef __EVICT_H__
+#define __EVICT_H__
+
+#include "types.h"
+
+// Forward Declarations
+typedef struct nbrs_info_t nbrs_info_t;
+
+// Function type definitions
+typedef uint32_t evict_func_t(nbrs_info_t*, void*);
+
+/*! evict_pol_t
+ *
+ * Entry in the eviction policy table
+ */
+typedef struct evict_pol_t {
+    /*! name
+     *
+     * Name used when printing
+     */
+    const char *name;
+
+    /*! pick
+     *
+     * Called with a full table and the policy's ctx. Returns the slot
+     * to evict, or INVALID_INDEX if it can't pick one.
+     */
+    evict_func_t *pick;
+
+    /*! ctx
+     *
+     * Per-policy state, handed to pick untouched
+     */
+    void *ctx;
+} evict_pol_t;
+
+// Policies (possible values for nbrs_info_t::pol)
+#define POL_EVICT_OLDEST        0x1
+#define POL_EVICT_FARTHEST      0x2
+#define POL_EVICT_FEWEST_LINKS  0x3
+#define POL_EVICT_FEWEST_REFS   0x4
+#define POL_EVICT_STALEST       0x5
+#define EVICT_N_POLS            0x8
+
+// What the robot runs with: stalest once distances carry an age to go
+// by, oldest otherwise, where stalest would only find the unranged
+#ifdef NBI_DIST_AGE
+#define POL_EVICT_DEFAULT       POL_EVICT_STALEST
+#else
+#define POL_EVICT_DEFAULT       POL_EVICT_OLDEST
+#endif
+
+// Policy table
+bool evict_register(uint8_t pol, const char *name,
+                    evict_func_t *pick, void *ctx);
+evict_pol_t *evict_get_pol(uint8_t pol);
+uint32_t evict_pick(nbrs_info_t *nbi, uint8_t pol);
+
+#endif
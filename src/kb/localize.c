@@ -3,11 +3,19 @@
 #include "constants.h"
 #include "types.h"
 #include "kb_math.h"
+#include "kb_fastmath.h"
 #include "nbi.h"
 #include "state.h"
 
 #include "err.h"
 
+#ifdef LOC_STATS
+localize_stats_t localize_stats;
+#define LOC_STAT(field) (++localize_stats.field)
+#else
+#define LOC_STAT(field)
+#endif
+
 /*! place
  *
  * Place a neighbor on the x-axis, and update the component array
@@ -29,16 +37,22 @@ _place(
     pt.y = 0.0f;
 
     // covers only a single point at this time
+    n->comp->start_angle = 0.0f;
     n->comp->coverage = 0.0f;
     n->comp->max_nbr = n;
     n->comp->min_nbr = n;
 
+    // placed from nothing but ourselves, it roots the frame
+    n->refs[0] = NBR_REF_NONE;
+    n->refs[1] = NBR_REF_NONE;
+    n->frame = NBI_NBR_ID(nbi, pt_i);
+    n->loc_stamp = nbi->dist_clock;
+
     // update the location
-    n->last_loc = n->loc;
-    n->loc = pt;
+    nbi_nbr_set_loc(nbi, pt_i, pt);
 
     // mark this neighbor localized
-    nbr_set_localized(n);
+    nbi_nbr_set_localized(nbi, pt_i);
 
 err:
     return;
@@ -47,12 +61,14 @@ err:
 /*! Triangulation algorithm
  *
  * Triangulates a neighbor using ourselves and one reference point.
+ * row holds the distances from pt_i.
  */
 static void
 _triangulate(
     nbrs_info_t *nbi,
     uint32_t pt_i,
-    uint32_t ref_i)
+    uint32_t ref_i,
+    const kb_dist_t *row)
 {
     point_t pt = {0,0};
     ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
@@ -64,19 +80,19 @@ _triangulate(
     ASSERT_OR_ERR(n && ref, err, KB_ERR_INPUT);
 
     // distnace to pt to localize
-    kb_dist_t ab = nbi_get_dist(nbi, pt_i, pt_i);
+    kb_dist_t ab = row[pt_i];
     // distance to ref pt
     kb_dist_t ac = nbi_get_dist(nbi, ref_i, ref_i);
     // distance between pt to triangulate and ref
-    kb_dist_t bc = nbi_get_dist(nbi, pt_i, ref_i);
+    kb_dist_t bc = row[ref_i];
 
     // compute angle subtended by pt and ref through origin
     // choice of theta versus -theta means we choose to place
     // this point counterclockwise from its reference
     // rather than clockwise
     float theta = angled(ab, ac, bc);
-    float costheta = cos(theta);
-    float sintheta = sin(theta);
+    float costheta, sintheta;
+    kb_sincos(theta, &sintheta, &costheta);
 
     // compute relative coordinates assuming reference lies along
     // x-axis
@@ -84,9 +100,9 @@ _triangulate(
     pt.y = ab*sintheta;
 
     // compute angle of reference point
-    float reftheta = atan2(ref->loc.y, ref->loc.x);
-    costheta = cos(reftheta);
-    sintheta = sin(reftheta);
+    point_t ref_loc = NBI_NBR_LOC(nbi, ref_i);
+    float reftheta = kb_atan2(ref_loc.y, ref_loc.x);
+    kb_sincos(reftheta, &sintheta, &costheta);
 
     // rotate point by theta in either direction to get
     // possible locations
@@ -108,16 +124,16 @@ _triangulate(
             continue;
         }
 
-        nbr_t *nbr = nbi_get_nbr(nbi, i);
+        point_t nbr_loc = NBI_NBR_LOC(nbi, i);
 
         // if ref has a neighbor which should neighbor
         // one of our points, then return the other. in cases
         // where the choice is symmetrical, we pick counterclockwise
         if (nbi_is_adj(nbi, ref_i, i)) {
-            if (l2_sq(nbr->loc, ptcw) <= COMM_RANGE*COMM_RANGE) {
+            if (l2_sq(nbr_loc, ptcw) <= COMM_RANGE*COMM_RANGE) {
                 pt = ptccw;
             }
-            if (l2_sq(nbr->loc, ptccw) <= COMM_RANGE*COMM_RANGE) {
+            if (l2_sq(nbr_loc, ptccw) <= COMM_RANGE*COMM_RANGE) {
                 cov_angle = reftheta - theta;
                 pt = ptcw;
             }
@@ -125,18 +141,23 @@ _triangulate(
     }
 
     if (isnan(pt.x) || isnan(pt.y)) {
+        LOC_STAT(nan_drops);
         DEBUG_PRINT("found nan: (%.2f, %.2f)", pt.x, pt.y);
         return;
     }
 
     // update location
-    n->last_loc = n->loc;
-    n->loc = pt;
+    nbi_nbr_set_loc(nbi, pt_i, pt);
+
+    n->refs[0] = ref_i;
+    n->refs[1] = NBR_REF_NONE;
+    n->frame = ref->frame;
+    n->loc_stamp = nbi->dist_clock;
 
     // update the component
     n->comp = ref->comp;
     netcomp_update(nbi, ref->comp, n);
-    nbr_set_localized(n);
+    nbi_nbr_set_localized(nbi, pt_i);
 
 err:
     return;
@@ -145,7 +166,7 @@ err:
 /*! Trilateration algorithm
  *
  * Trilaterate point i using ourselves and points j and k as reference
- * points
+ * points. row holds the distances from point i.
  *
  * Computation is taken from
  * https://en.wikipedia.org/wiki/Trilateration#Derivation
@@ -155,7 +176,8 @@ _trilaterate(
     nbrs_info_t *nbi,
     uint32_t pt_i,
     uint32_t ref1_i, 
-    uint32_t ref2_i)
+    uint32_t ref2_i,
+    const kb_dist_t *row)
 {
     point_t point = {0,0};
 
@@ -166,8 +188,8 @@ _trilaterate(
     nbr_t *ref2 = nbi_get_nbr(nbi, ref2_i);
     ASSERT_OR_ERR(nbr && ref1 && ref2, err, KB_ERR_INPUT);
 
-    point_t ref1_pt = ref1->loc;
-    point_t ref2_pt = ref2->loc;
+    point_t ref1_pt = NBI_NBR_LOC(nbi, ref1_i);
+    point_t ref2_pt = NBI_NBR_LOC(nbi, ref2_i);
     // if the second one is aligned to the x axis, switch them
     // to avoid computing the angle
     if (ref2_pt.y == 0 && ref1_pt.y != 0) {
@@ -188,11 +210,11 @@ _trilaterate(
     }
 
     // distance from self to the point to trilaterate
-    float r1 = nbi_get_dist(nbi, pt_i, pt_i);
+    float r1 = row[pt_i];
     // distance from point to the first reference point
-    float r2 = nbi_get_dist(nbi, pt_i, ref1_i);
+    float r2 = row[ref1_i];
     // distance from point to the second reference point
-    float r3 = nbi_get_dist(nbi, pt_i, ref2_i);
+    float r3 = row[ref2_i];
 
     float theta = 0.0f;
     float sintheta = 0.0f;
@@ -200,9 +222,8 @@ _trilaterate(
 
     // rotate only things if we're not using an aligned reference
     if (ref1_pt.y != 0) {
-        theta = atan2((float)ref1_pt.y, (float)ref1_pt.x);
-        sintheta = sin(theta);
-        costheta = cos(theta);
+        theta = kb_atan2((float)ref1_pt.y, (float)ref1_pt.x);
+        kb_sincos(theta, &sintheta, &costheta);
     }
 
     // distance from self to first reference point
@@ -218,6 +239,7 @@ _trilaterate(
 
     // if it's a problem, it's also on the x-axis
     if (isnan(rely) || isinf(rely)) {
+        LOC_STAT(nan_fallbacks);
         rely = 0.0f;
     }
 
@@ -230,105 +252,444 @@ _trilaterate(
         point.y = rely;
     }
 
-    // compute angle of point relative to component local coordinates
-    float angle = atan2(point.y, point.x);
-
     if (isnan(point.x) || isnan(point.y)) {
+        LOC_STAT(nan_fallbacks);
         DEBUG_PRINT("found nan: (%.2f, %.2f), r1: %.2f, r2: %.2f, r3: %.2f, d: %.2f, i: %.2f, j: %.2f", point.x, point.y, r1, r2, r3, d, i, j);
         return;
     }
 
+    // the references give no real fix, the first one alone does better
+    if (fabsf(sqrtf(relx*relx + rely*rely) - r1) > LOC_RESIDUAL_MAX) {
+        LOC_STAT(resid_fallbacks);
+        _triangulate(nbi, pt_i, ref1_i, row);
+        return;
+    }
+
     // update the point
-    nbr->last_loc = nbr->loc;
-    nbr->loc = point;
+    nbi_nbr_set_loc(nbi, pt_i, point);
+    nbr->refs[0] = ref1_i;
+    nbr->refs[1] = ref2_i;
+    nbr->frame = ref1->frame;
+    nbr->loc_stamp = nbi->dist_clock;
 
-    // compute angle of point relative to ref1
-    float relangle = atan2(rely, relx);
     // update the component
     nbr->comp = ref1->comp;
-    // if relative to our fixed reference point we're closer cw than ccw,
-    // use it as a cw angle
-    if (relangle > PI) {
-        angle -= TWO_PI;
-    }
     netcomp_update(nbi, nbr->comp, nbr);
-    nbr_set_localized(nbr);
+    nbi_nbr_set_localized(nbi, pt_i);
 
 err:
     return;
 }
 
+/*! Multilateration algorithm
+ *
+ * Least squares fit of point pt_i to ourselves and the nrefs reference
+ * points in refs. Taking our own circle away from each reference's
+ * leaves one linear equation per reference, solved through the 2x2
+ * normal equations. row holds the distances from point i. The point is
+ * only placed if the fit is within LOC_RESIDUAL_MAX; refs[0] and
+ * refs[1] are kept as its references, the rest only refine the fit.
+ *
+ * Returns the RMS of the range residuals in mm, or a negative value if
+ * the references are too close to in line with us to fit against
+ */
+static float
+_multilaterate(
+    nbrs_info_t *nbi,
+    uint32_t pt_i,
+    const uint32_t *refs,
+    uint32_t nrefs,
+    const kb_dist_t *row)
+{
+    ASSERT_OR_ERR(nbi && refs && nrefs >= 2, err, KB_ERR_INPUT);
+
+    nbr_t *nbr = nbi_get_nbr(nbi, pt_i);
+    nbr_t *ref1 = nbi_get_nbr(nbi, refs[0]);
+    ASSERT_OR_ERR(nbr && ref1, err, KB_ERR_INPUT);
+
+    // distance from self to the point to place
+    float r0 = row[pt_i];
+
+    // sum up the normal equations, reference k at a_k with range r_k
+    // gives a_k . p = (r0^2 - r_k^2 + |a_k|^2) / 2
+    float sxx = 0.0f, sxy = 0.0f, syy = 0.0f;
+    float sxb = 0.0f, syb = 0.0f;
+    for (uint32_t k = 0; k < nrefs; ++k) {
+        point_t a = NBI_NBR_LOC(nbi, refs[k]);
+        float rk = row[refs[k]];
+        float b = 0.5f * (r0*r0 - rk*rk + a.x*a.x + a.y*a.y);
+        sxx += a.x*a.x;
+        sxy += a.x*a.y;
+        syy += a.y*a.y;
+        sxb += a.x*b;
+        syb += a.y*b;
+    }
+
+    // the same cutoff as picking a pair, for two equally distant
+    // references det/(tr/2)^2 is the squared sine of their angle
+    float det = sxx*syy - sxy*sxy;
+    float tr = sxx + syy;
+    if (det <= 0.25f * LOC_PAIR_SIN_MIN * LOC_PAIR_SIN_MIN * tr * tr) {
+        return -1.0f;
+    }
+
+    point_t point = {
+        (syy*sxb - sxy*syb) / det,
+        (sxx*syb - sxy*sxb) / det
+    };
+
+    // how far off every range the fit is, ours included
+    float e = sqrtf(point.x*point.x + point.y*point.y) - r0;
+    float sse = e*e;
+    for (uint32_t k = 0; k < nrefs; ++k) {
+        point_t a = NBI_NBR_LOC(nbi, refs[k]);
+        float dx = point.x - a.x;
+        float dy = point.y - a.y;
+        e = sqrtf(dx*dx + dy*dy) - row[refs[k]];
+        sse += e*e;
+    }
+    float residual = sqrtf(sse / (nrefs + 1));
+
+    if (residual > LOC_RESIDUAL_MAX) {
+        return residual;
+    }
+
+    // update the point
+    nbi_nbr_set_loc(nbi, pt_i, point);
+    nbr->refs[0] = refs[0];
+    nbr->refs[1] = refs[1];
+    nbr->frame = ref1->frame;
+    nbr->loc_stamp = nbi->dist_clock;
+
+    // update the component
+    nbr->comp = ref1->comp;
+    netcomp_update(nbi, nbr->comp, nbr);
+    nbi_nbr_set_localized(nbi, pt_i);
+
+    return residual;
+
+err:
+    return -1.0f;
+}
+
 /*! localize_one
  *
- * Attempt to completely localize a single neighbor
+ * Attempt to completely localize a single neighbor, fitting it to at
+ * most max_refs references
  */
 static void
 _localize_one(
     nbrs_info_t *nbi,
-    uint32_t nbr_i) 
+    uint32_t nbr_i,
+    uint32_t max_refs)
 {
     ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
 
     nbr_t *nbr = nbi_get_nbr(nbi, nbr_i);
     ASSERT_OR_ERR(nbr, err, KB_ERR_INPUT);
 
-    // try to find two localized references
-    uint32_t nrefs = 0;
-    uint32_t refs[2];
-    refs[0] = nbi_find_nbr(nbi, nbr_i, 0, NBR_LOCALIZED);
-    if (refs[0] != INVALID_INDEX) {
-        refs[1] = nbi_find_nbr(nbi, nbr_i, refs[0]+1, NBR_LOCALIZED);
+    // gather the localized references, each only as fresh as the older
+    // of its link to nbr_i and its own range
+    uint32_t ncands = 0;
+    uint32_t cands[MAX_NEIGHBORS];
+    uint16_t ages[MAX_NEIGHBORS];
+    kb_mask_t m = nbi_query_nbrs(nbi, nbr_i, NBR_LOCALIZED);
+    for (uint32_t j; (j = mask_pop(&m)) != INVALID_INDEX; ) {
+        uint16_t age = nbi_get_dist_age(nbi, nbr_i, j);
+        uint16_t own = nbi_get_dist_age(nbi, j, j);
+        if (own > age) {
+            age = own;
+        }
+        // everything fresh enough is as good as anything else
+        if (age < NBI_DIST_AGE_STALE) {
+            age = 0;
+        }
+        cands[ncands] = j;
+        ages[ncands] = age;
+        ++ncands;
+    }
 
-        // set number of references found
-        if (refs[1] != INVALID_INDEX) {
+    // score every pair: the freshest first, then the one spanning the
+    // most area with us. trilaterating divides by how far the second
+    // reference is off the line through us and the first, so pairs
+    // close to in line with us are what blow up
+    uint32_t refs[MAX_NEIGHBORS] = { INVALID_INDEX, INVALID_INDEX };
+    uint16_t best_age = 0xffff;
+    float best_area = -1.0f;
+    for (uint32_t a = 0; a < ncands; ++a) {
+        point_t pa = NBI_NBR_LOC(nbi, cands[a]);
+        for (uint32_t b = a + 1; b < ncands; ++b) {
+            point_t pb = NBI_NBR_LOC(nbi, cands[b]);
+            uint16_t age = (ages[a] > ages[b])? ages[a] : ages[b];
+            float area = fabsf(pa.x * pb.y - pa.y * pb.x);
+            if (age < best_age || (age == best_age && area > best_area)) {
+                refs[0] = cands[a];
+                refs[1] = cands[b];
+                best_age = age;
+                best_area = area;
+            }
+        }
+    }
+
+    // a pair nearly in line with us fixes nothing the nearer of the
+    // two doesn't alone, triangulate from that one instead
+    uint32_t nrefs = ncands;
+    if (ncands == 1) {
+        refs[0] = cands[0];
+    } else if (ncands > 1) {
+        float ra = nbi_get_dist(nbi, refs[0], refs[0]);
+        float rb = nbi_get_dist(nbi, refs[1], refs[1]);
+        if (best_area >= LOC_PAIR_SIN_MIN * ra * rb) {
             nrefs = 2;
         } else {
             nrefs = 1;
+            if (rb < ra) {
+                refs[0] = refs[1];
+            }
+        }
+    }
+
+    // with a usable pair, anyone else as fresh can join the fit
+    if (nrefs == 2) {
+        for (uint32_t c = 0; c < ncands && nrefs < max_refs; ++c) {
+            if (ages[c] <= best_age
+                    && cands[c] != refs[0] && cands[c] != refs[1])
+            {
+                refs[nrefs++] = cands[c];
+            }
+        }
+    }
+
+    // everything below reads distances from nbr_i, fetch them at once
+    kb_dist_t row[MAX_NEIGHBORS];
+    if (nrefs > 0) {
+        nbi_get_dist_row(nbi, nbr_i, row);
+    }
+
+    // with more than two, fit to all of them. if they don't agree, the
+    // best pair alone still might
+    if (nrefs > 2) {
+        LOC_STAT(fits);
+        float residual = _multilaterate(nbi, nbr_i, refs, nrefs, row);
+        if (residual >= 0.0f && residual <= LOC_RESIDUAL_MAX) {
+            return;
         }
+        LOC_STAT(resid_fallbacks);
+        nrefs = 2;
     }
 
     // if we found both references, we can trilaterate
     if (nrefs == 2) {
-        _trilaterate(nbi, nbr_i, refs[0], refs[1]);
+        _trilaterate(nbi, nbr_i, refs[0], refs[1], row);
     }
 
     // otherwise if we only found one, we can just triangulate
     // making a choice--if it's wrong that's ok
     else if (nrefs == 1) {
-        _triangulate(nbi, nbr_i, refs[0]);
+        _triangulate(nbi, nbr_i, refs[0], row);
     }
     
     // if we didn't find any references we failed to
     // localize them this round
     else {
-        nbr_clr_localized(nbr);
+        nbi_nbr_clr_localized(nbi, nbr_i);
     }
 
 err:
     return;
 }
 
+/*! _align
+ *
+ * Rotate, and mirror if that fits better, the freshly localized
+ * component comp onto the locations its members had before this pass
+ * (left in last_loc). prev holds the members that had one. Keeps the
+ * component frame, and with it the heading odometry tracks in it,
+ * continuous across passes.
+ *
+ * Returns false if there was too little of the old layout left to line
+ * up with
+ */
+static bool
+_align(
+    nbrs_info_t *nbi,
+    netcomp_t *comp,
+    kb_mask_t prev)
+{
+    // sums for the best rotation as is (dot, cross) and mirrored
+    float dot = 0.0f, cross = 0.0f;
+    float mdot = 0.0f, mcross = 0.0f;
+    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
+        if (!(prev & MASK_BIT(i)) || nbi->nbrs[i].comp != comp
+                || !nbi_nbr_is_localized(nbi, i))
+        {
+            continue;
+        }
+        point_t n = nbi_nbr_get_loc(nbi, i);
+        point_t o = nbi->nbrs[i].last_loc;
+        dot += n.x * o.x + n.y * o.y;
+        cross += n.x * o.y - n.y * o.x;
+        mdot += n.x * o.x - n.y * o.y;
+        mcross += n.x * o.y + n.y * o.x;
+    }
+
+    float fit = dot * dot + cross * cross;
+    float mfit = mdot * mdot + mcross * mcross;
+    bool mirror = mfit > fit;
+    if (mirror) {
+        dot = mdot;
+        cross = mcross;
+        fit = mfit;
+    }
+    if (fit < 1.0f) {
+        return false;
+    }
+
+    float norm = sqrtf(fit);
+    float c = dot / norm;
+    float s = cross / norm;
+    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
+        if (nbi->nbrs[i].comp != comp || !nbi_nbr_is_localized(nbi, i)) {
+            continue;
+        }
+        point_t p = nbi_nbr_get_loc(nbi, i);
+        if (mirror) {
+            p.y = -p.y;
+        }
+        point_t q = {c * p.x - s * p.y, s * p.x + c * p.y};
+        nbi_nbr_set_loc(nbi, i, q);
+    }
+
+    // mirroring swaps which end of the component is which
+    if (mirror) {
+        nbr_t *tmp = comp->max_nbr;
+        comp->max_nbr = comp->min_nbr;
+        comp->min_nbr = tmp;
+    }
+    return true;
+}
+
+/*! _frame
+ *
+ * The frame comp can keep: the id of a clean member that roots its
+ * own frame, preferring the anchor. KB_ID_INVALID if there is none,
+ * i.e. the neighbor the frame hung off is gone, or its range moved.
+ */
+static kb_id_t
+_frame(
+    nbrs_info_t *nbi,
+    netcomp_t *comp,
+    kb_mask_t clean)
+{
+    nbr_t *a = comp->anchor;
+    if (MASK_IS_SET(clean, a->idx) && a->frame == NBI_NBR_ID(nbi, a->idx)) {
+        return a->frame;
+    }
+
+    for (uint32_t i; (i = mask_pop(&clean)) != INVALID_INDEX; ) {
+        nbr_t *n = &nbi->nbrs[i];
+        if (n->comp == comp && n->frame == NBI_NBR_ID(nbi, i)) {
+            return n->frame;
+        }
+    }
+    return KB_ID_INVALID;
+}
+
+/*! _orphans
+ *
+ * Add to redo every localized neighbor placed from one that is being
+ * redone, is gone, or isn't localized, until nothing more follows
+ */
+static kb_mask_t
+_orphans(
+    nbrs_info_t *nbi,
+    kb_mask_t loc,
+    kb_mask_t redo)
+{
+    bool grew = true;
+    while (grew) {
+        grew = false;
+        kb_mask_t m = loc & ~redo;
+        for (uint32_t i; (i = mask_pop(&m)) != INVALID_INDEX; ) {
+            nbr_t *n = &nbi->nbrs[i];
+            if (n->frame == NBI_NBR_ID(nbi, i)) {
+                continue;
+            }
+
+            // removing a neighbor drops references to it
+            bool orphan = (n->refs[0] == NBR_REF_NONE);
+            for (uint32_t r = 0; r < 2 && !orphan; ++r) {
+                uint8_t ref = n->refs[r];
+                orphan = ref != NBR_REF_NONE
+                    && (ref >= nbi->n_nbrs || MASK_IS_SET(redo, ref)
+                        || !MASK_IS_SET(loc, ref));
+            }
+            if (orphan) {
+                redo |= MASK_BIT(i);
+                grew = true;
+            }
+        }
+    }
+    return redo;
+}
+
+/*! _cover
+ *
+ * Rebuild the angular extent of comp from its localized members
+ */
+static void
+_cover(
+    nbrs_info_t *nbi,
+    netcomp_t *comp)
+{
+    comp->max_nbr = NULL;
+    comp->min_nbr = NULL;
+    comp->start_angle = 0.0f;
+    comp->coverage = 0.0f;
+
+    kb_mask_t m = nbi_get_flag_mask(nbi, NBR_LOCALIZED);
+    for (uint32_t i; (i = mask_pop(&m)) != INVALID_INDEX; ) {
+        if (nbi->nbrs[i].comp == comp) {
+            netcomp_update(nbi, comp, &nbi->nbrs[i]);
+        }
+    }
+}
+
 /*! localize_all
  *
- * This function updates the local coordinate system.
- * Picks the furthest neighbor to lie on the x-axis
- * for a canonical choice.
+ * This function updates the local coordinate system, keeping the
+ * locations of everyone it can from the last pass.
  *
  * Algorithm:
  *
- * 1. Build components
- *      - Determines local neighborhood segmentation
- * 2. Place one element of each component
- *      - For each component of the network, place a single nbr
- *      canonically.
- * 3. Localize all remaining neighbors
+ * 1. Components
+ *      - Kept current by the nbi as links come and go, so there is
+ *      nothing to build here
+ * 2. Decide what to redo
+ *      - Neighbors the nbi marked dirty, anyone not localized, and
+ *      anyone placed from one of those.
+ *      - A component whose frame root is gone or dirty is rebuilt
+ *      from scratch, its anchor placed canonically on the x-axis.
+ *      Members of other frames (components that merged) are redone
+ *      in the one that's kept.
+ * 3. Localize everyone being redone
  *      - Maximum (comp_sz* - 1) rounds (comp_sz* is maximum number
  *      of neighbors in a single component)
+ *      - Each is fit to up to max_refs localized references. 2 only
+ *      ever trilaterates from the best pair, more fits by least
+ *      squares over that many when there are enough.
  *      - For each newly localized neighbor, update detailed component
  *      information to keep track of the network layout.
+ *
+ * Skipped entirely if the table generation hasn't moved since the last
+ * complete pass and nobody has been marked dirty since.
+ *
+ * Returns true if a pass was run
  */
-void
-localize_all(state_t *st)
+bool
+localize_all(
+    state_t *st,
+    uint32_t max_refs)
 {
     ASSERT_OR_ERR(st, err, KB_ERR_INPUT);
 
@@ -336,29 +697,76 @@ localize_all(state_t *st)
 
     // short circuit if we don't have any neighbors at all
     if (nbi->n_nbrs == 0) {
-        return;
+        return false;
     }
 
-    // 1: Build components
-    nbi_segment_nbrs(nbi);
+    // or if nothing has changed since the last complete pass
+    if (nbi_is_localized(nbi) && nbi_get_gen(nbi) == nbi->localized_gen
+            && nbi->loc_dirty == MASK_NONE) {
+        return false;
+    }
 
     //
     // If there are too many components, we need more
     // information to take a stab at localization
     //
-    if (nbi->n_comps >= 5) {
+    if (nbi->n_comps >= NBI_MAX_COMPS) {
         nbi->flags &= ~(NBI_LOCALIZED);
-        return;
+        return false;
+    }
+    LOC_STAT(passes);
+
+    kb_mask_t live = MASK_LOW(nbi->n_nbrs);
+    kb_mask_t prev = nbi_get_flag_mask(nbi, NBR_LOCALIZED);
+    kb_mask_t redo = (nbi->loc_dirty | ~prev) & live;
+
+    // odometry error piles up in locations carried along for too long
+    kb_mask_t m = prev;
+    for (uint32_t i; (i = mask_pop(&m)) != INVALID_INDEX; ) {
+        uint16_t age = nbi->dist_clock - nbi->nbrs[i].loc_stamp;
+        if (age > NBI_DIST_AGE_STALE) {
+            redo |= MASK_BIT(i);
+        }
     }
 
-    // Clear localization status of all neighbors
+    // sort out which frames survive. a component that lost its frame
+    // starts over, members of any other frame are redone in the kept one
+    kb_mask_t rebuild = MASK_NONE;
+    kb_id_t frames[NBI_MAX_COMPS];
+    for (uint32_t c = 0; c < nbi->n_comps; ++c) {
+        frames[c] = _frame(nbi, &nbi->comps[c], prev & ~redo);
+    }
     for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
+        uint32_t c = nbi->nbrs[i].comp - nbi->comps;
+        if (frames[c] == KB_ID_INVALID) {
+            rebuild |= MASK_BIT(i);
+        } else if (nbi->nbrs[i].frame != frames[c]) {
+            redo |= MASK_BIT(i);
+        }
+    }
+    redo = _orphans(nbi, prev & ~rebuild, redo | rebuild);
+
+    // and which component the heading is tracked in
+    netcomp_t *heading_comp = NULL;
+    m = prev;
+    for (uint32_t i; (i = mask_pop(&m)) != INVALID_INDEX; ) {
+        if (nbi->nbrs[i].frame == nbi->heading_frame) {
+            heading_comp = nbi->nbrs[i].comp;
+            break;
+        }
+    }
+
+    // Clear localization status of everyone being redone
+    m = redo & prev;
+    for (uint32_t i; (i = mask_pop(&m)) != INVALID_INDEX; ) {
         nbi_nbr_clr_localized(nbi, i);
     }
 
-    // Place the first (by index) element in each component
-    for (uint32_t i = 0; i < nbi->n_comps; ++i) {
-        _place(nbi, nbi->comps[i].min_nbr->idx);
+    // Place the anchor (first by index) of each component starting over
+    for (uint32_t c = 0; c < nbi->n_comps; ++c) {
+        if (frames[c] == KB_ID_INVALID) {
+            _place(nbi, nbi->comps[c].anchor->idx);
+        }
     }
 
     // then try to do all of them
@@ -370,36 +778,104 @@ localize_all(state_t *st)
             break;
         }
         someone_changed = false;
+        LOC_STAT(rounds);
 
-        // try to place all MAX_NEIGHBORS in the coordinate system
-        for (uint32_t j = 0; j < nnbrs; ++j) {
-            nbr_t *nbr = nbi_get_nbr(nbi, j);
-
-            // don't need to try to relocalize already-localized
-            // points
-            if (nbr_is_localized(nbr)) {
-                continue;
-            }
-
+        // try to place everyone still waiting in the coordinate system
+        kb_mask_t todo = redo & ~nbi_get_flag_mask(nbi, NBR_LOCALIZED);
+        for (uint32_t j; (j = mask_pop(&todo)) != INVALID_INDEX; ) {
             // try to localize j
-            _localize_one(nbi, j);
+            LOC_STAT(attempts);
+            _localize_one(nbi, j, max_refs);
 
             // if we failed to localize this point, we need at least
             // one more round
-            if (!nbr_is_localized(nbr)) {
+            if (!nbi_nbr_is_localized(nbi, j)) {
                 someone_changed = true;
             }
         }
     }
 
-    // once everyone has been localized, check to see if any components
-    // are full
-    for (uint32_t i = 0; i < nbi->n_comps; ++i) {
-        netcomp_check_full(nbi, &nbi->comps[i]);
+    // once everyone has been localized, line each rebuilt component up
+    // with where it was, and check to see if any components are full
+    for (uint32_t c = 0; c < nbi->n_comps; ++c) {
+        if (frames[c] == KB_ID_INVALID) {
+            // lined up with where it was, the heading carries over into
+            // the new frame. otherwise odometry starts it over
+            if (_align(nbi, &nbi->comps[c], prev)
+                    && heading_comp == &nbi->comps[c]) {
+                nbi->heading_frame = nbi->comps[c].anchor->frame;
+            }
+        } else {
+            _cover(nbi, &nbi->comps[c]);
+        }
+        netcomp_check_full(nbi, &nbi->comps[c]);
     }
 
     // if we got here, we can call everything localized
     nbi_set_flag(nbi, NBI_LOCALIZED);
+    nbi->localized_gen = nbi_get_gen(nbi);
+    nbi->loc_dirty = MASK_NONE;
+    return true;
+
+err:
+    return false;
+}
+
+/*! localize_sched
+ *
+ * Run localize_all if it's due under the given schedule, counting the
+ * loops a pass actually ran in and the ones that went by without one,
+ * whether the schedule held it back or localize_all found nothing to do
+ *
+ * Returns true if a pass was run
+ */
+bool
+localize_sched(
+    state_t *st,
+    const localize_sched_t *sched)
+{
+    ASSERT_OR_ERR(st && sched, err, KB_ERR_INPUT);
+
+    nbrs_info_t *nbi = st->nbi;
+
+    // everyone the next pass would have to redo
+    kb_mask_t waiting = (nbi->loc_dirty
+            | ~nbi_get_flag_mask(nbi, NBR_LOCALIZED))
+        & MASK_LOW(nbi->n_nbrs);
+
+    if (!nbi_flag_is_set(nbi, NBI_LOC_DEMAND)
+            && st->ticks - nbi->loc_ticks < sched->period
+            && mask_count(waiting) < sched->min_dirty)
+    {
+        ++nbi->loc_skips;
+        return false;
+    }
+
+    nbi_clr_flag(nbi, NBI_LOC_DEMAND);
+    nbi->loc_ticks = st->ticks;
+
+    if (!localize_all(st, sched->max_refs)) {
+        ++nbi->loc_skips;
+        return false;
+    }
+
+    ++nbi->loc_runs;
+    return true;
+
+err:
+    return false;
+}
+
+/*! localize_demand
+ *
+ * Have the next localize_sched run a pass whatever the schedule says
+ */
+void
+localize_demand(state_t *st)
+{
+    ASSERT_OR_ERR(st, err, KB_ERR_INPUT);
+
+    nbi_set_flag(st->nbi, NBI_LOC_DEMAND);
 
 err:
     return;
@@ -16,6 +16,43 @@
 // forward declarations
 typedef struct state_t state_t;
 
-void localize_all(state_t *st);
+/*! localize_sched_t
+ *
+ * How fresh a state wants its coordinates. A pass is run once period
+ * ticks have gone by since the last one, as soon as min_dirty neighbors
+ * are waiting to be redone, or whenever one was demanded. A min_dirty
+ * of 0 runs every loop. Each pass fits neighbors to up to max_refs
+ * references.
+ */
+typedef struct localize_sched_t {
+    kb_time_t period;
+    uint8_t min_dirty;
+    uint8_t max_refs;
+} localize_sched_t;
+
+bool localize_all(state_t *st, uint32_t max_refs);
+
+#ifdef LOC_STATS
+/*! localize_stats_t
+ *
+ * Running counts of what localization did, for offline runs. Only
+ * kept when built with LOC_STATS.
+ */
+typedef struct localize_stats_t {
+    uint32_t passes;        // passes that got past the short circuits
+    uint32_t rounds;        // rounds over the neighbors still waiting
+    uint32_t attempts;      // neighbors tried, over all rounds
+    uint32_t nan_fallbacks; // trilaterations that came out NaN or infinite
+    uint32_t nan_drops;     // triangulations that came out NaN, not placed
+    uint32_t resid_fallbacks; // fits off or ill-conditioned, fallen back from
+    uint32_t fits;          // multilateration fits
+} localize_stats_t;
+
+extern localize_stats_t localize_stats;
+#endif
+
+// Scheduling
+bool localize_sched(state_t *st, const localize_sched_t *sched);
+void localize_demand(state_t *st);
 
 #endif
@@ -194,8 +194,8 @@ MSG_DEFAULT_RX_NAME(NONE)(
 
 /*! msg_rx_handler_id
  *
- * Handle an ID neighbor message, using it to update
- * our neighbor info arrays and start gossiping
+ * Handle an ID neighbor message. Runs in the rx callback, so the
+ * update is only staged; msg_rx_apply picks it up in the loop.
  */
 void
 MSG_DEFAULT_RX_NAME(ID)(
@@ -207,27 +207,15 @@ MSG_DEFAULT_RX_NAME(ID)(
     ASSERT_OR_ERR(msg->type == MSG_NAME(ID), err, KB_ERR_INPUT);
 
     msg_data_id_t *m_id = (msg_data_id_t*)msg;
-
-    // update our arrays
-    uint32_t nbr_idx = nbi_update_id(st->nbi, m_id->sender_id, st->ticks);
-    nbi_set_dist(st->nbi, nbr_idx, nbr_idx, dist);
-
-    // gossip result if it was new information
-    if (st->nbi->last_new_ticks == st->ticks) {
-        msg_data_ohn_t *m = (msg_data_ohn_t*)msg_data_create(st, MSG_NAME(OHN));
-        m->sender_id = kilo_uid;
-        m->ohn_id = m_id->sender_id;
-        m->ohn_dist = dist;
-        state_push_msg(st, (msg_data_t*)m);
-    }
+    nbi_rx_push(st->nbi, m_id->sender_id, dist, KB_ID_INVALID, 0);
 err:
     return;
 }
 
 /*! msg_rx_handler_ohn
  *
- * Handle a one-hop neighbor message, using it to update
- * our neighbor info arrays
+ * Handle a one-hop neighbor message. Runs in the rx callback, so the
+ * update is only staged; msg_rx_apply picks it up in the loop.
  */
 void
 MSG_DEFAULT_RX_NAME(OHN)(
@@ -239,28 +227,60 @@ MSG_DEFAULT_RX_NAME(OHN)(
     ASSERT_OR_ERR(msg->type == MSG_NAME(OHN), err, KB_ERR_INPUT);
 
     msg_data_ohn_t *m_ohn = (msg_data_ohn_t*)msg;
+    nbi_rx_push(st->nbi, m_ohn->sender_id, dist,
+            m_ohn->ohn_id, m_ohn->ohn_dist);
+err:
+    return;
+}
+
+/*! msg_rx_apply
+ *
+ * Apply every neighbor update staged since the last call to our
+ * neighbor info arrays (distances through the filter), a batch at a
+ * time, and gossip the ones that told us something new. Called from
+ * the loop at the start of each tick, so everything after it in the
+ * tick sees one consistent table.
+ */
+void
+msg_rx_apply(state_t *st)
+{
+    ASSERT_OR_ERR(st, err, KB_ERR_INPUT);
 
-    // update our arrays
-    uint32_t nbr_idx = nbi_update_id(st->nbi, m_ohn->sender_id, st->ticks);
-    uint32_t ohn_idx = nbi_get_nbr_idx(st->nbi, m_ohn->ohn_id);
-    nbi_set_dist(st->nbi, nbr_idx, nbr_idx, dist);
-    if (ohn_idx != INVALID_INDEX) {
-        if (!nbi_is_adj(st->nbi, nbr_idx, ohn_idx)) {
-            nbi_set_adj(st->nbi, nbr_idx, ohn_idx);
-            st->nbi->last_new_ticks = st->ticks;
+    // once anything is new this tick, everything after it is passed on
+    bool fresh = (st->nbi->last_new_ticks == st->ticks);
+
+    nbi_rx_t rx[NBI_RX_BATCH_SIZE];
+    uint32_t n;
+    do {
+        n = 0;
+        while (n < NBI_RX_BATCH_SIZE && nbi_rx_pop(st->nbi, &rx[n])) {
+            ++n;
         }
-        nbi_set_dist(st->nbi, nbr_idx, ohn_idx, m_ohn->ohn_dist);
-    }
 
-    // gossip result if we got new information
-    if (st->nbi->last_new_ticks == st->ticks)
-    {
-        msg_data_ohn_t *m = (msg_data_ohn_t*)msg_data_create(st, MSG_NAME(OHN));
-        m->sender_id = kilo_uid;
-        m->ohn_id = m_ohn->sender_id;
-        m->ohn_dist = dist;
-        state_push_msg(st, (msg_data_t*)m);
-    }
+        nbi_rx_sum_t sum;
+        if (n == 0 || !nbi_rx_apply(st->nbi, rx, n, st->ticks, &sum)) {
+            continue;
+        }
+
+        // gossip result if we got new information
+        for (uint32_t k = 0; k < n; ++k) {
+            fresh = fresh || (sum.news & (1 << k));
+            if (!fresh || !(sum.applied & (1 << k))) {
+                continue;
+            }
+
+            msg_data_ohn_t *m =
+                (msg_data_ohn_t*)msg_data_create(st, MSG_NAME(OHN));
+            if (!m) {
+                continue;
+            }
+            m->sender_id = kilo_uid;
+            m->ohn_id = rx[k].id;
+            m->ohn_dist = rx[k].dist;
+            state_push_msg(st, (msg_data_t*)m);
+        }
+    } while (n == NBI_RX_BATCH_SIZE);
+
 err:
     return;
 }
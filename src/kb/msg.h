@@ -134,6 +134,9 @@ msg_data_t *msg_data_create(state_t *st, uint8_t type);
 void msg_data_init(msg_data_t *msg, uint8_t type);
 void msg_data_delete(msg_data_t *msg);
 
+// Staged neighbor updates
+void msg_rx_apply(state_t *st);
+
 // Debug
 char *msg_data_getstr(uint8_t type);
 void msg_data_print(void *msg, char *pref);
@@ -8,8 +8,780 @@
 #include "bitarray.h"
 #include "constants.h"
 #include "kb_math.h"
+#include "kb_fastmath.h"
 #include "err.h"
 
+/*! NBI_BARRIER
+ *
+ * Compiler barrier. The rx callback and the loop share one core, so
+ * keeping the compiler from reordering ring accesses is enough.
+ */
+#define NBI_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+/*! _nbi_id_hash
+ *
+ * Multiplicative hash of a neighbor id into the id index
+ */
+static uint32_t
+_nbi_id_hash(kb_id_t id)
+{
+    return (((uint32_t)id * 40503u) & 0xffff) >> (16 - NBI_ID_INDEX_BITS);
+}
+
+/*! _nbi_id_index_find
+ *
+ * Find the position of id in the id index, or INVALID_INDEX if
+ * it isn't there
+ */
+static uint32_t
+_nbi_id_index_find(
+    nbrs_info_t *nbi,
+    kb_id_t id)
+{
+    uint32_t pos = _nbi_id_hash(id);
+    for (uint32_t n = 0; n < NBI_ID_INDEX_SIZE; ++n) {
+        uint8_t slot = nbi->id_index[pos];
+        if (slot == NBI_ID_INDEX_EMPTY) {
+            break;
+        }
+        if (NBI_NBR_ID(nbi, slot) == id) {
+            return pos;
+        }
+        pos = (pos + 1) & (NBI_ID_INDEX_SIZE - 1);
+    }
+
+    return INVALID_INDEX;
+}
+
+/*! _nbi_id_index_insert
+ *
+ * Record that the neighbor in slot idx is findable by its id. The id
+ * must already be written into the slot.
+ */
+static void
+_nbi_id_index_insert(
+    nbrs_info_t *nbi,
+    uint32_t idx)
+{
+    uint32_t pos = _nbi_id_hash(NBI_NBR_ID(nbi, idx));
+    while (nbi->id_index[pos] != NBI_ID_INDEX_EMPTY) {
+        pos = (pos + 1) & (NBI_ID_INDEX_SIZE - 1);
+    }
+    nbi->id_index[pos] = idx;
+}
+
+/*! _nbi_id_index_remove
+ *
+ * Remove id from the index. Uses backward-shift deletion so lookups
+ * never need tombstones.
+ */
+static void
+_nbi_id_index_remove(
+    nbrs_info_t *nbi,
+    kb_id_t id)
+{
+    uint32_t hole = _nbi_id_index_find(nbi, id);
+    if (hole == INVALID_INDEX) {
+        return;
+    }
+
+    uint32_t pos = hole;
+    for (;;) {
+        pos = (pos + 1) & (NBI_ID_INDEX_SIZE - 1);
+        uint8_t slot = nbi->id_index[pos];
+        if (slot == NBI_ID_INDEX_EMPTY) {
+            break;
+        }
+
+        // distance from the home position of the entry at pos to pos,
+        // and to the hole. entries can only move back towards home.
+        uint32_t home = _nbi_id_hash(NBI_NBR_ID(nbi, slot));
+        uint32_t to_pos = (pos - home) & (NBI_ID_INDEX_SIZE - 1);
+        uint32_t to_hole = (hole - home) & (NBI_ID_INDEX_SIZE - 1);
+        if (to_hole < to_pos) {
+            nbi->id_index[hole] = slot;
+            hole = pos;
+        }
+    }
+    nbi->id_index[hole] = NBI_ID_INDEX_EMPTY;
+}
+
+/*! _nbi_adj_set
+ *
+ * Static helper to link i and j in both rows
+ */
+static void
+_nbi_adj_set(
+    nbrs_info_t *nbi,
+    uint32_t i,
+    uint32_t j)
+{
+#ifdef NBI_ADJ_BITMAT
+    bm_set(nbi->adj, i, j);
+#else
+    nbi->adj[i] |= MASK_BIT(j);
+    nbi->adj[j] |= MASK_BIT(i);
+#endif
+}
+
+/*! _nbi_adj_clr
+ *
+ * Static helper to unlink i and j in both rows
+ */
+static void
+_nbi_adj_clr(
+    nbrs_info_t *nbi,
+    uint32_t i,
+    uint32_t j)
+{
+#ifdef NBI_ADJ_BITMAT
+    bm_clr(nbi->adj, i, j);
+#else
+    nbi->adj[i] &= ~MASK_BIT(j);
+    nbi->adj[j] &= ~MASK_BIT(i);
+#endif
+}
+
+/*! _nbi_adj_clr_row
+ *
+ * Static helper to drop every link to/from idx
+ */
+static void
+_nbi_adj_clr_row(
+    nbrs_info_t *nbi,
+    uint32_t idx)
+{
+    kb_mask_t row = NBI_ADJ_ROW(nbi, idx);
+    while (row != MASK_NONE) {
+        _nbi_adj_clr(nbi, idx, mask_first(row));
+        row &= row - 1;
+    }
+}
+
+/*! _nbi_comp_find
+ *
+ * Find the root of the component containing idx, halving the
+ * path on the way up
+ */
+static uint32_t
+_nbi_comp_find(
+    nbrs_info_t *nbi,
+    uint32_t idx)
+{
+    while (nbi->comp_parent[idx] != idx) {
+        nbi->comp_parent[idx] = nbi->comp_parent[nbi->comp_parent[idx]];
+        idx = nbi->comp_parent[idx];
+    }
+    return idx;
+}
+
+/*! _nbi_comp_union
+ *
+ * Join the components of i and j. The smaller root wins so that the
+ * root stays the smallest index in the component.
+ *
+ * @return true if two different components were merged
+ */
+static bool
+_nbi_comp_union(
+    nbrs_info_t *nbi,
+    uint32_t i,
+    uint32_t j)
+{
+    uint32_t ri = _nbi_comp_find(nbi, i);
+    uint32_t rj = _nbi_comp_find(nbi, j);
+    if (ri == rj) {
+        return false;
+    }
+
+    if (ri < rj) {
+        nbi->comp_parent[rj] = ri;
+    } else {
+        nbi->comp_parent[ri] = rj;
+    }
+    return true;
+}
+
+/*! _nbi_comp_relabel
+ *
+ * Point every neighbor at the netcomp_t for its union-find root.
+ * Components are handed out in order of their smallest index, and
+ * each is reset to contain only its anchor.
+ */
+static void
+_nbi_comp_relabel(nbrs_info_t *nbi)
+{
+    uint32_t ncomps = 0;
+    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
+        uint32_t root = _nbi_comp_find(nbi, i);
+
+        // anything that isn't a root was connected to a smaller index
+        // which has already been labeled
+        if (root != i) {
+            nbi->nbrs[i].comp = nbi->nbrs[root].comp;
+            continue;
+        }
+
+        // if we have too many components, we don't have enough
+        // information to compute anything
+        if (ncomps >= NBI_MAX_COMPS) {
+            nbi->nbrs[i].comp = NULL;
+            continue;
+        }
+
+        netcomp_t *comp = &nbi->comps[ncomps++];
+        // clear any prevous component info
+        netcomp_init(comp);
+        comp->anchor = &nbi->nbrs[i];
+        // add nbr i to the component
+        netcomp_update(nbi, comp, &nbi->nbrs[i]);
+
+        nbi->nbrs[i].comp = comp;
+    }
+    nbi->n_comps = ncomps;
+
+    // components were just reset, so gather their repulsion sums back
+    // up from the terms the members already carry
+    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
+        netcomp_t *comp = nbi->nbrs[i].comp;
+        if (comp) {
+            comp->repulse.x += nbi->nbrs[i].repulse.x;
+            comp->repulse.y += nbi->nbrs[i].repulse.y;
+        }
+    }
+}
+
+/*! _nbi_two_hop_promote
+ *
+ * Turn every two-hop entry about the neighbor now in slot idx into a
+ * link and distance from the neighbor that reported it. Entries whose
+ * reporter is gone or which have timed out are just dropped.
+ */
+static void
+_nbi_two_hop_promote(
+    nbrs_info_t *nbi,
+    uint32_t idx,
+    kb_time_t ticks)
+{
+    kb_id_t id = NBI_NBR_ID(nbi, idx);
+    for (uint32_t k = 0; k < NBI_TWO_HOP_SIZE; ++k) {
+        nbi_two_hop_t *th = &nbi->two_hop[k];
+        if (th->via == KB_ID_INVALID || th->id != id) {
+            continue;
+        }
+
+        uint32_t via_idx = nbi_get_nbr_idx(nbi, th->via);
+        if (via_idx != INVALID_INDEX
+                && ticks - th->last_time <= NEIGHBOR_TIMEOUT_TICKS)
+        {
+            nbi_set_adj(nbi, via_idx, idx);
+            nbi_filter_dist(nbi, via_idx, idx, th->dist);
+        }
+        th->via = KB_ID_INVALID;
+    }
+}
+
+/*! _nbi_dist_clock_advance
+ *
+ * Run the distance age clock forward by ticks, faster if we moved.
+ * Whenever it crosses a multiple of NBI_DIST_AGE_MAX, older stamps are
+ * pulled up to NBI_DIST_AGE_MAX so no age can ever wrap.
+ */
+static void
+_nbi_dist_clock_advance(
+    nbrs_info_t *nbi,
+    uint32_t ticks,
+    bool moving)
+{
+    uint32_t step = ticks * (moving? NBI_DIST_AGE_MOVING : 1);
+    if (step > NBI_DIST_AGE_MAX) {
+        step = NBI_DIST_AGE_MAX;
+    }
+
+    uint16_t prev = nbi->dist_clock;
+    nbi->dist_clock += step;
+#ifdef NBI_DIST_AGE
+    if (((prev ^ nbi->dist_clock) & ~(NBI_DIST_AGE_MAX - 1)) == 0) {
+        return;
+    }
+
+    uint16_t floor = nbi->dist_clock - NBI_DIST_AGE_MAX;
+    uint32_t n = matu16_tri_idx(nbi->n_nbrs, 0);
+    for (uint32_t k = 0; k < n; ++k) {
+        if ((uint16_t)(nbi->dist_clock - nbi->dist_stamp[k]) > NBI_DIST_AGE_MAX) {
+            nbi->dist_stamp[k] = floor;
+        }
+    }
+#else
+    (void)prev;
+#endif
+}
+
+/*! _nbi_odom_rates
+ *
+ * Motion per tick for each action: mm forward, rad ccw, and the
+ * lateral offset of the leg we pivot on (positive is to our left)
+ */
+static const float _nbi_odom_rates[][3] = {
+    [SA_STOP]      = {0.0f, 0.0f, 0.0f},
+    [SA_FORWARD]   = {ODOM_FWD_RATE, 0.0f, 0.0f},
+    [SA_RIGHT]     = {0.0f, -ODOM_TURN_RATE, -ODOM_PIVOT_R},
+    [SA_LEFT]      = {0.0f, ODOM_TURN_RATE, ODOM_PIVOT_R},
+    [SA_FWD_RIGHT] = {0.75f * ODOM_FWD_RATE, -0.5f * ODOM_TURN_RATE, 0.0f},
+    [SA_FWD_LEFT]  = {0.75f * ODOM_FWD_RATE, 0.5f * ODOM_TURN_RATE, 0.0f},
+};
+
+/*! _nbi_dist_predicted
+ *
+ * Check whether a new distance for (i, j) agrees with the locations
+ * we already hold. i == j is our own range to i.
+ */
+static bool
+_nbi_dist_predicted(
+    nbrs_info_t *nbi,
+    uint32_t i,
+    uint32_t j,
+    kb_dist_t dist)
+{
+    if (dist == KB_DIST_INVALID
+            || !(NBI_NBR_FLAGS(nbi, i) & NBR_LOCALIZED)
+            || !(NBI_NBR_FLAGS(nbi, j) & NBR_LOCALIZED))
+    {
+        return false;
+    }
+
+    point_t a = NBI_NBR_LOC(nbi, i);
+    point_t b = {0.0f, 0.0f};
+    if (i != j) {
+        // locations in different components aren't comparable
+        if (nbi->nbrs[i].comp != nbi->nbrs[j].comp) {
+            return false;
+        }
+        b = NBI_NBR_LOC(nbi, j);
+    }
+
+    float pred = sqrtf(l2_sq(a, b));
+    return fabsf(pred - dist) <= ODOM_DIST_TOL;
+}
+
+/*! _nbi_repulse_term
+ *
+ * Repulsion from a neighbor at loc: points away from it with a
+ * magnitude of 1/|loc|. Anything closer than 1mm contributes nothing
+ * rather than blowing up.
+ */
+static point_t
+_nbi_repulse_term(point_t loc)
+{
+    point_t term = {0.0f, 0.0f};
+    float d_sq = loc.x * loc.x + loc.y * loc.y;
+    if (d_sq >= 1.0f) {
+        term.x = -loc.x / d_sq;
+        term.y = -loc.y / d_sq;
+    }
+    return term;
+}
+
+/*! _nbi_repulse_refresh
+ *
+ * Recompute neighbor idx's repulsion term and fold the difference
+ * into its component's sum. Called whenever its location or
+ * localized flag changes, so the sums never need a full pass.
+ */
+static void
+_nbi_repulse_refresh(
+    nbrs_info_t *nbi,
+    uint32_t idx)
+{
+    nbr_t *nbr = &nbi->nbrs[idx];
+    point_t term = {0.0f, 0.0f};
+    if (NBI_NBR_FLAGS(nbi, idx) & NBR_LOCALIZED) {
+        term = _nbi_repulse_term(NBI_NBR_LOC(nbi, idx));
+    }
+
+    if (nbr->comp) {
+        nbr->comp->repulse.x += term.x - nbr->repulse.x;
+        nbr->comp->repulse.y += term.y - nbr->repulse.y;
+    }
+    nbr->repulse = term;
+}
+
+/*! _nbi_comp_members
+ *
+ * Mask of the neighbors in the component rooted at root
+ */
+static kb_mask_t
+_nbi_comp_members(
+    nbrs_info_t *nbi,
+    uint32_t root)
+{
+    kb_mask_t members = MASK_NONE;
+    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
+        if (_nbi_comp_find(nbi, i) == root) {
+            members |= MASK_BIT(i);
+        }
+    }
+    return members;
+}
+
+/*! _nbi_comp_split
+ *
+ * Split members back into singletons and rejoin them using the
+ * remaining adjacency. members has to be made of whole components.
+ * Neighbors aren't pointed at their new components until the next
+ * _nbi_comp_relabel.
+ */
+static void
+_nbi_comp_split(
+    nbrs_info_t *nbi,
+    kb_mask_t members)
+{
+    kb_mask_t m = members;
+    for (uint32_t i; (i = mask_pop(&m)) != INVALID_INDEX; ) {
+        nbi->comp_parent[i] = i;
+    }
+
+    m = members;
+    for (uint32_t i; (i = mask_pop(&m)) != INVALID_INDEX; ) {
+        // only links to smaller members, each link is seen once
+        kb_mask_t row = NBI_ADJ_ROW(nbi, i) & members & (MASK_BIT(i) - 1);
+        while (row != MASK_NONE) {
+            _nbi_comp_union(nbi, i, mask_first(row));
+            row &= row - 1;
+        }
+    }
+}
+
+/*! _nbi_comp_rebuild
+ *
+ * Rebuild only the component rooted at root after a link inside it
+ * went away
+ */
+static void
+_nbi_comp_rebuild(
+    nbrs_info_t *nbi,
+    uint32_t root)
+{
+    _nbi_comp_split(nbi, _nbi_comp_members(nbi, root));
+    _nbi_comp_relabel(nbi);
+}
+
+/*! _nbi_comp_add
+ *
+ * Start a freshly (re)initialized slot off as its own component
+ */
+static void
+_nbi_comp_add(
+    nbrs_info_t *nbi,
+    uint32_t idx)
+{
+    nbi->comp_parent[idx] = idx;
+    _nbi_comp_relabel(nbi);
+}
+
+/*! _nbi_comp_resync
+ *
+ * Rebuild the whole union-find forest from the adjacency rows
+ */
+static void
+_nbi_comp_resync(nbrs_info_t *nbi)
+{
+    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
+        // initially set components equal to themselves
+        nbi->comp_parent[i] = i;
+    }
+
+    for (uint32_t i = 1; i < nbi->n_nbrs; ++i) {
+        // only links to smaller indices, each link is seen once
+        kb_mask_t row = NBI_ADJ_ROW(nbi, i) & (MASK_BIT(i) - 1);
+        while (row != MASK_NONE) {
+            _nbi_comp_union(nbi, i, mask_first(row));
+            row &= row - 1;
+        }
+    }
+
+    _nbi_comp_relabel(nbi);
+}
+
+/*! _nbi_nbr_reset
+ *
+ * (Re)initialize the neighbor in slot idx, wherever its fields live
+ */
+static void
+_nbi_nbr_reset(
+    nbrs_info_t *nbi,
+    uint32_t idx,
+    kb_id_t id)
+{
+    nbr_init(&nbi->nbrs[idx], id);
+
+    NBI_NBR_ID(nbi, idx) = id;
+    NBI_NBR_LAST_TIME(nbi, idx) = kilo_ticks;
+    NBI_NBR_FLAGS(nbi, idx) = 0;
+    nbi->localized &= ~MASK_BIT(idx);
+    nbi->loc_dirty |= MASK_BIT(idx);
+    NBI_NBR_LOC(nbi, idx).x = 0.0f;
+    NBI_NBR_LOC(nbi, idx).y = 0.0f;
+}
+
+/*! _nbi_wheel_bucket
+ *
+ * Timing wheel bucket for something last heard at ticks
+ */
+static uint32_t
+_nbi_wheel_bucket(kb_time_t ticks)
+{
+    return (ticks / NBI_WHEEL_WIDTH) % (NBI_WHEEL_SLOTS + 1);
+}
+
+/*! _nbi_wheel_touch
+ *
+ * Mark neighbor idx as heard from at ticks, moving it to the matching
+ * wheel bucket. Pass insert = true for a slot not yet on the wheel.
+ */
+static void
+_nbi_wheel_touch(
+    nbrs_info_t *nbi,
+    uint32_t idx,
+    kb_time_t ticks,
+    bool insert)
+{
+    if (!insert) {
+        nbi->wheel[_nbi_wheel_bucket(NBI_NBR_LAST_TIME(nbi, idx))] &= ~MASK_BIT(idx);
+    }
+    NBI_NBR_LAST_TIME(nbi, idx) = ticks;
+    nbi->wheel[_nbi_wheel_bucket(ticks)] |= MASK_BIT(idx);
+}
+
+/*! _nbi_journal_edge
+ *
+ * Append an edge to one of the journal edge lists, flagging overflow
+ * if it is full
+ */
+static void
+_nbi_journal_edge(
+    nbrs_info_t *nbi,
+    nbi_edge_t *edges,
+    uint8_t *n_edges,
+    uint32_t i,
+    uint32_t j)
+{
+    if (*n_edges < NBI_JOURNAL_EDGES) {
+        edges[*n_edges].i = i;
+        edges[*n_edges].j = j;
+        ++*n_edges;
+    } else {
+        nbi->journal.flags |= NBI_JOURNAL_OVERFLOW;
+    }
+    ++nbi->journal.gen;
+}
+
+/*! _nbi_nbr_remove
+ *
+ * Forget everything about the neighbor in slot idx: its id, wheel
+ * entry, distances, links and any localization references to it. The
+ * slot itself is left for the caller to reuse or compact away, and so
+ * is fixing up the components.
+ */
+static void
+_nbi_nbr_remove(
+    nbrs_info_t *nbi,
+    uint32_t idx)
+{
+    // drop it from the id index while its id is still valid
+    _nbi_id_index_remove(nbi, NBI_NBR_ID(nbi, idx));
+    nbi->wheel[_nbi_wheel_bucket(NBI_NBR_LAST_TIME(nbi, idx))] &= ~MASK_BIT(idx);
+
+    // clear the info structure
+    nbr_clean(&nbi->nbrs[idx]);
+    _nbi_nbr_reset(nbi, idx, KB_ID_INVALID);
+
+    // localization references to it are gone with it, whoever gets the
+    // slot next is someone else. anyone placed from it has to be redone
+    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
+        nbr_t *n = &nbi->nbrs[i];
+        for (uint32_t r = 0; r < 2; ++r) {
+            if (n->refs[r] == idx) {
+                n->refs[r] = NBR_REF_NONE;
+                nbi->loc_dirty |= MASK_BIT(i);
+            }
+        }
+    }
+
+    // clear recorded distances and links. both are cleared directly
+    // so the journal just records the eviction. slots past n_nbrs
+    // never hold any
+    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
+        matu16_set(nbi->pd, i, idx, KB_DIST_INVALID);
+#ifdef NBI_DIST_EMA
+        nbi->dist_ema[matu16_tri_idx(i, idx)] = NBI_DIST_EMA_EMPTY;
+#endif
+    }
+    _nbi_adj_clr_row(nbi, idx);
+
+    nbi->journal.evicted |= MASK_BIT(idx);
+    ++nbi->journal.gen;
+}
+
+/*! _nbi_dist_copy
+ *
+ * Copy the distance of pair (si, sj) and whatever is kept alongside
+ * it over to pair (di, dj)
+ */
+static void
+_nbi_dist_copy(
+    nbrs_info_t *nbi,
+    uint32_t di,
+    uint32_t dj,
+    uint32_t si,
+    uint32_t sj)
+{
+    matu16_set(nbi->pd, di, dj, matu16_get(nbi->pd, si, sj));
+#ifdef NBI_DIST_EMA
+    nbi->dist_ema[matu16_tri_idx(di, dj)] = nbi->dist_ema[matu16_tri_idx(si, sj)];
+#endif
+#ifdef NBI_DIST_AGE
+    nbi->dist_stamp[matu16_tri_idx(di, dj)] = nbi->dist_stamp[matu16_tri_idx(si, sj)];
+#endif
+}
+
+/*! _nbi_nbr_move
+ *
+ * Move the neighbor in slot src into the empty slot dst, along with
+ * everything indexed by its slot. src is left empty.
+ */
+static void
+_nbi_nbr_move(
+    nbrs_info_t *nbi,
+    uint32_t src,
+    uint32_t dst)
+{
+    // the id index and wheel hold slots, repoint them while src still
+    // has its id
+    uint32_t pos = _nbi_id_index_find(nbi, NBI_NBR_ID(nbi, src));
+    if (pos != INVALID_INDEX) {
+        nbi->id_index[pos] = dst;
+    }
+    uint32_t bucket = _nbi_wheel_bucket(NBI_NBR_LAST_TIME(nbi, src));
+    nbi->wheel[bucket] = (nbi->wheel[bucket] & ~MASK_BIT(src)) | MASK_BIT(dst);
+
+    // the record itself
+    nbi->nbrs[dst] = nbi->nbrs[src];
+    nbi->nbrs[dst].idx = dst;
+#ifdef NBI_SOA
+    NBI_NBR_ID(nbi, dst) = NBI_NBR_ID(nbi, src);
+    NBI_NBR_LAST_TIME(nbi, dst) = NBI_NBR_LAST_TIME(nbi, src);
+    NBI_NBR_FLAGS(nbi, dst) = NBI_NBR_FLAGS(nbi, src);
+    NBI_NBR_LOC(nbi, dst) = NBI_NBR_LOC(nbi, src);
+#endif
+    if (nbi->localized & MASK_BIT(src)) {
+        nbi->localized |= MASK_BIT(dst);
+    }
+    if (!(nbi->loc_dirty & MASK_BIT(src))) {
+        nbi->loc_dirty &= ~MASK_BIT(dst);
+    }
+
+    // distances. dst's row is already clear, src's moves over
+    for (uint32_t k = 0; k < nbi->n_nbrs; ++k) {
+        if (k == src || k == dst) continue;
+        _nbi_dist_copy(nbi, dst, k, src, k);
+    }
+    _nbi_dist_copy(nbi, dst, dst, src, src);
+    for (uint32_t k = 0; k < nbi->n_nbrs; ++k) {
+        matu16_set(nbi->pd, src, k, KB_DIST_INVALID);
+#ifdef NBI_DIST_EMA
+        nbi->dist_ema[matu16_tri_idx(src, k)] = NBI_DIST_EMA_EMPTY;
+#endif
+    }
+
+    // links
+    kb_mask_t row = NBI_ADJ_ROW(nbi, src);
+    _nbi_adj_clr_row(nbi, src);
+    while (row != MASK_NONE) {
+        uint32_t k = mask_first(row);
+        row &= row - 1;
+        _nbi_adj_set(nbi, dst, (k == src? dst : k));
+    }
+
+    _nbi_nbr_reset(nbi, src, KB_ID_INVALID);
+}
+
+/*! _nbi_journal_compact
+ *
+ * Fix up the journal for src moving into dst, whose neighbor was just
+ * removed. Both slots end up marked evicted since their occupants
+ * changed; edges of the removed neighbor are dropped.
+ */
+static void
+_nbi_journal_compact(
+    nbrs_info_t *nbi,
+    uint32_t src,
+    uint32_t dst)
+{
+    nbi_journal_t *jn = &nbi->journal;
+    kb_mask_t from = MASK_BIT(src);
+    kb_mask_t to = MASK_BIT(dst);
+
+    jn->added = (jn->added & ~(from | to)) | ((jn->added & from)? to : 0);
+    jn->ranged = (jn->ranged & ~(from | to)) | ((jn->ranged & from)? to : 0);
+    jn->evicted |= from | to;
+
+    nbi_edge_t *lists[2] = {jn->edges_added, jn->edges_removed};
+    uint8_t *counts[2] = {&jn->n_edges_added, &jn->n_edges_removed};
+    for (uint32_t l = 0; l < 2; ++l) {
+        uint8_t n = 0;
+        for (uint8_t e = 0; e < *counts[l]; ++e) {
+            nbi_edge_t edge = lists[l][e];
+            if (edge.i == dst || edge.j == dst) continue;
+            if (edge.i == src) edge.i = dst;
+            if (edge.j == src) edge.j = dst;
+            lists[l][n++] = edge;
+        }
+        *counts[l] = n;
+    }
+}
+
+/*! _nbi_nbr_compact
+ *
+ * Fill the just-emptied slot dst with the last neighbor so that live
+ * neighbors stay packed in [0, n_nbrs). Only the two components that
+ * changed are rebuilt: the removed neighbor's and the moved one's.
+ */
+static void
+_nbi_nbr_compact(
+    nbrs_info_t *nbi,
+    uint32_t dst)
+{
+    uint32_t src = nbi->n_nbrs - 1;
+
+    // localization references to src follow it, _nbi_nbr_remove
+    // already dropped the ones to dst
+    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
+        nbr_t *n = &nbi->nbrs[i];
+        for (uint32_t r = 0; r < 2; ++r) {
+            if (n->refs[r] == src) {
+                n->refs[r] = dst;
+            }
+        }
+    }
+    _nbi_journal_compact(nbi, src, dst);
+
+    // the removed neighbor's component lost its links through dst, and
+    // the moved one's gets renumbered, so its root may not be its
+    // smallest index any more. nobody else's is touched
+    kb_mask_t members = _nbi_comp_members(nbi, _nbi_comp_find(nbi, dst))
+        | _nbi_comp_members(nbi, _nbi_comp_find(nbi, src));
+
+    if (src != dst) {
+        _nbi_nbr_move(nbi, src, dst);
+    }
+    --nbi->n_nbrs;
+
+    _nbi_comp_split(nbi, members & MASK_LOW(nbi->n_nbrs));
+    _nbi_comp_relabel(nbi);
+    ++nbi->journal.gen;
+}
+
 /*! nbi_create
  *
  * Constructor for nbrs_info_t
@@ -46,11 +818,16 @@ nbi_init(
     uint32_t max_nbrs,
     uint8_t pol,
     nbr_t *nbrs, uint32_t nbrs_sz,
-    matf_t *pd, float *pd_data, uint32_t pd_data_sz,
-    bitmat_t *adj, uint8_t *adj_data, uint32_t adj_data_sz)
+    matu16_t *pd, uint16_t *pd_data, uint32_t pd_data_sz
+#ifdef NBI_ADJ_BITMAT
+    , bitmat_t *adj, uint8_t *adj_data, uint32_t adj_data_sz
+#endif
+    )
 {
     ASSERT_OR_ERR(nbi && max_nbrs > 0 && nbrs && nbrs_sz == max_nbrs,
             err, KB_ERR_INPUT);
+    ASSERT_OR_ERR(2*max_nbrs <= NBI_ID_INDEX_SIZE, err, KB_ERR_INPUT);
+    ASSERT_OR_ERR(evict_get_pol(pol), err, KB_ERR_INPUT);
 
     // init direct parameters
     nbi->n_nbrs = 0;
@@ -61,25 +838,77 @@ nbi_init(
     nbi->nbrs = nbrs;
 
     // initialize the neighbor array with invalid indices
+    nbi->localized = MASK_NONE;
+    nbi->loc_dirty = MASK_NONE;
     for (uint32_t i = 0; i < max_nbrs; ++i) {
-        nbr_init(&nbi->nbrs[i], KB_ID_INVALID);
+        _nbi_nbr_reset(nbi, i, KB_ID_INVALID);
 
         // setup the indices for each
         nbi->nbrs[i].idx = i;
+
+        // everyone starts out in their own component
+        nbi->comp_parent[i] = i;
+    }
+
+    // nobody is indexed yet
+    memset(nbi->id_index, NBI_ID_INDEX_EMPTY, sizeof(nbi->id_index));
+
+    // or on the timing wheel
+    memset(nbi->wheel, 0, sizeof(nbi->wheel));
+    nbi->wheel_window = 0;
+    nbi->n_expired = 0;
+
+    // start with a clean journal
+    memset(&nbi->journal, 0, sizeof(nbi->journal));
+    nbi->localized_gen = 0;
+
+    // nor any localization scheduled yet
+    nbi->loc_ticks = kilo_ticks;
+    nbi->loc_runs = 0;
+    nbi->loc_skips = 0;
+
+    // and facing along the x-axis of whatever frame we end up with
+    nbi->heading = 0.0f;
+    nbi->heading_frame = KB_ID_INVALID;
+    nbi->odom_ticks = kilo_ticks;
+
+    // and nothing staged
+    nbi->rx_head = 0;
+    nbi->rx_tail = 0;
+    nbi->rx_dropped = 0;
+
+    // nor gossip about anyone further out
+    for (uint32_t i = 0; i < NBI_TWO_HOP_SIZE; ++i) {
+        nbi->two_hop[i].via = KB_ID_INVALID;
     }
 
     // setup the pairwise distance matrix
     nbi->pd = pd;
-    matf_init(nbi->pd, max_nbrs, 0, MATF_SYMMETRIC, pd_data, pd_data_sz);
+    matu16_init(nbi->pd, max_nbrs, 0, MATU16_SYMMETRIC, pd_data, pd_data_sz);
+    matu16_fill(nbi->pd, KB_DIST_INVALID);
+#ifdef NBI_DIST_EMA
+    memset(nbi->dist_ema, 0xff, sizeof(nbi->dist_ema));
+#endif
+#ifdef NBI_DIST_AGE
+    memset(nbi->dist_stamp, 0, sizeof(nbi->dist_stamp));
+#endif
+    nbi->dist_clock = 0;
 
     // setup the adjacency matrix
+#ifdef NBI_ADJ_BITMAT
     nbi->adj = adj;
     bm_init(nbi->adj, max_nbrs, 0, BM_SYMMETRIC, adj_data, adj_data_sz);
+#else
+    memset(nbi->adj, 0, sizeof(nbi->adj));
+#endif
 
     // initalize all the components
-    for (uint32_t i = 0; i < 5; ++i) {
+    for (uint32_t i = 0; i < NBI_MAX_COMPS; ++i) {
         netcomp_init(&nbi->comps[i]);
     }
+    nbi->n_comps = 0;
+    nbi->repulse.x = 0.0f;
+    nbi->repulse.y = 0.0f;
 
     return;
 err:
@@ -96,8 +925,10 @@ nbi_clean(nbrs_info_t *nbi)
 {
     if (nbi == NULL) return;
 
+#ifdef NBI_ADJ_BITMAT
     bm_delete(nbi->adj);
-    matf_delete(nbi->pd);
+#endif
+    matu16_delete(nbi->pd);
 
     if (nbi->nbrs) {
         for (uint32_t i = 0; i < nbi->max_nbrs; ++i) {
@@ -159,7 +990,7 @@ err:
 
 /*! nbi_get_nbr_idx
  *
- * Traverse the neighbor array to find an index
+ * Look up the index of a neighbor through the id index
  */
 uint32_t
 nbi_get_nbr_idx(
@@ -168,10 +999,9 @@ nbi_get_nbr_idx(
 {
     ASSERT_OR_ERR(nbi && id != KB_ID_INVALID, err, KB_ERR_INPUT);
 
-    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
-        if (nbi->nbrs[i].id == id) {
-            return i;
-        }
+    uint32_t pos = _nbi_id_index_find(nbi, id);
+    if (pos != INVALID_INDEX) {
+        return nbi->id_index[pos];
     }
 
 err:
@@ -196,11 +1026,24 @@ nbi_update_id(
     uint32_t idx = nbi_get_nbr_idx(nbi, id);
     if (idx != INVALID_INDEX) {
         nbr = nbi_get_nbr(nbi, idx);
+        _nbi_wheel_touch(nbi, idx, ticks, false);
     } else {
-        // increment the number of neighbors and
-        // initialize it
-        nbr = &nbi->nbrs[nbi->n_nbrs++];
-        nbr_init(nbr, id);
+        // take the next free slot, evicting someone if we're full,
+        // and initialize it
+        idx = nbi_evict_nbr(nbi);
+        ASSERT_OR_ERR(idx != INVALID_INDEX, err, KB_ERR_EVICT);
+
+        nbr = &nbi->nbrs[idx];
+        _nbi_nbr_reset(nbi, idx, id);
+        _nbi_wheel_touch(nbi, idx, ticks, true);
+        _nbi_id_index_insert(nbi, idx);
+        _nbi_comp_add(nbi, idx);
+
+        nbi->journal.added |= MASK_BIT(idx);
+        ++nbi->journal.gen;
+
+        // pick up whatever we'd already heard about it
+        _nbi_two_hop_promote(nbi, idx, ticks);
 
         // mark the last updated time
         nbi->last_new_ticks = ticks;
@@ -212,9 +1055,11 @@ err:
     return INVALID_INDEX;
 }
 
+#ifndef NBI_SOA
 /*! nbi_add_nbr
  *
- * Add a neighbor to the array
+ * Add a neighbor to the array. Not available with NBI_SOA, where
+ * nbr_t no longer carries the whole record; use nbi_update_id.
  *
  * @return Index of the newly added neighbor
  */
@@ -239,6 +1084,12 @@ nbi_add_nbr(
 
     // once the index is decided, we can copy the data
     memcpy(&nbi->nbrs[idx], nbr, sizeof(nbr_t));
+    nbi->nbrs[idx].idx = idx;
+    _nbi_wheel_touch(nbi, idx, NBI_NBR_LAST_TIME(nbi, idx), true);
+    _nbi_id_index_insert(nbi, idx);
+    _nbi_comp_add(nbi, idx);
+    nbi->journal.added |= MASK_BIT(idx);
+    ++nbi->journal.gen;
     if (nbr->last_time > nbi->last_new_ticks) {
         nbi->last_new_ticks = nbr->last_time;
     }
@@ -247,6 +1098,7 @@ nbi_add_nbr(
 err:
     return INVALID_INDEX;
 }
+#endif
 
 /*! nbi_nbr_exists
  *
@@ -259,7 +1111,7 @@ nbi_nbr_exists(
 {
     ASSERT_OR_ERR(nbi && idx < nbi->n_nbrs, err, KB_ERR_INPUT);
 
-    return nbi->nbrs[idx].idx != KB_ID_INVALID;
+    return NBI_NBR_ID(nbi, idx) != KB_ID_INVALID;
 err:
     return false;
 }
@@ -278,15 +1130,57 @@ nbi_find_nbr(
     uint32_t st,
     uint8_t cond)
 {
-    for (uint32_t i = st; i < nbi->n_nbrs; ++i) {
-        if (nbi_is_adj(nbi, nbr_i, i)
-                && nbi_nbr_flag_is_set(nbi, i, cond))
-        {
-            return i;
+    if (st >= nbi->n_nbrs) {
+        return INVALID_INDEX;
+    }
+
+    // only look at the adjacent ones from st on
+    return mask_first(nbi_query_nbrs(nbi, nbr_i, cond) & ~(MASK_BIT(st) - 1));
+}
+
+/*! nbi_get_flag_mask
+ *
+ * Every neighbor with any of the flags in cond set, as a mask over
+ * slots
+ */
+kb_mask_t
+nbi_get_flag_mask(
+    nbrs_info_t *nbi,
+    uint8_t cond)
+{
+    ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
+
+    // NBR_LOCALIZED is kept as a mask, anything else needs a scan
+    kb_mask_t m = (cond & NBR_LOCALIZED)? nbi->localized : MASK_NONE;
+    cond &= ~NBR_LOCALIZED;
+    for (uint32_t i = 0; cond && i < nbi->n_nbrs; ++i) {
+        if (NBI_NBR_FLAGS(nbi, i) & cond) {
+            m |= MASK_BIT(i);
         }
     }
 
-    return INVALID_INDEX;
+    return m;
+err:
+    return MASK_NONE;
+}
+
+/*! nbi_query_nbrs
+ *
+ * Neighbors adjacent to nbr_i with any of the flags in cond set, as a
+ * mask over slots. Walk it with mask_pop, size it with mask_count and
+ * pick from it with mask_first/mask_nth.
+ */
+kb_mask_t
+nbi_query_nbrs(
+    nbrs_info_t *nbi,
+    uint32_t nbr_i,
+    uint8_t cond)
+{
+    ASSERT_OR_ERR(nbi && nbr_i < nbi->n_nbrs, err, KB_ERR_INPUT);
+
+    return NBI_ADJ_ROW(nbi, nbr_i) & nbi_get_flag_mask(nbi, cond);
+err:
+    return MASK_NONE;
 }
 
 /*! nbi_get_nnbrs
@@ -314,35 +1208,76 @@ nbi_evict_nbr(nbrs_info_t *nbi)
     }
 
     // otherwise use the eviction policy
-    uint32_t idx = INVALID_INDEX;
-    switch (nbi->pol) {
-        case POL_EVICT_OLDEST: {
-            // find the oldest
-            kb_time_t oldest = (kb_time_t)-1;
-            for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
-                if (nbi->nbrs[i].last_time < oldest) {
-                    oldest = nbi->nbrs[i].last_time;
-                    idx = i;
-                }
-            }
-            ASSERT_OR_GOTO(idx != INVALID_INDEX, err, "Error finding oldest");
-
-            // clear the info structure
-            nbr_clean(&nbi->nbrs[idx]);
-            // clear recorded distances
-            for (uint32_t i = 0; i < MAX_NEIGHBORS; ++i) {
-                nbi_clr_dist(nbi, i, idx);
-                nbi_clr_adj(nbi, i, idx);
+    uint32_t idx = evict_pick(nbi, nbi->pol);
+    ASSERT_OR_GOTO(idx < nbi->n_nbrs, err, "Error picking nbr to evict");
+
+    // the slot is reused straight away, so only its old component
+    // needs fixing
+    uint32_t root = _nbi_comp_find(nbi, idx);
+    _nbi_nbr_remove(nbi, idx);
+    _nbi_comp_rebuild(nbi, root);
+
+    return idx;
+err:
+    return INVALID_INDEX;
+}
+
+/*! nbi_expire_nbrs
+ *
+ * Advance the timing wheel to ticks and drop every neighbor we haven't
+ * heard from in NEIGHBOR_TIMEOUT_TICKS. Meant to be called once per
+ * loop; each call only visits the buckets whose window has passed, so
+ * the cost is amortized O(1) per tick plus, for each expired neighbor,
+ * compacting the last neighbor into its slot.
+ *
+ * @return Number of neighbors expired by this call
+ */
+uint32_t
+nbi_expire_nbrs(
+    nbrs_info_t *nbi,
+    kb_time_t ticks)
+{
+    ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
+
+    uint32_t n_expired = 0;
+    kb_time_t window = ticks / NBI_WHEEL_WIDTH;
+
+    // every window we move into reuses a bucket, so whatever is still in
+    // it was heard a full timeout ago. anything heard earlier in the
+    // current window shares the bucket, which is what the age check skips
+    kb_time_t steps = window - nbi->wheel_window;
+    if (steps > NBI_WHEEL_SLOTS + 1) {
+        steps = NBI_WHEEL_SLOTS + 1;
+    }
+    kb_mask_t expired = MASK_NONE;
+    for (kb_time_t k = 1; k <= steps; ++k) {
+        kb_mask_t bucket = nbi->wheel[(nbi->wheel_window + k) % (NBI_WHEEL_SLOTS + 1)];
+        while (bucket != MASK_NONE) {
+            uint32_t idx = mask_first(bucket);
+            bucket &= bucket - 1;
+
+            if (ticks - NBI_NBR_LAST_TIME(nbi, idx) >= NEIGHBOR_TIMEOUT_TICKS) {
+                expired |= MASK_BIT(idx);
             }
-            break;
         }
-        default:
-            goto err;
     }
 
-    return idx;
+    // remove from the top down, so whatever compaction moves into a
+    // freed slot has already been checked
+    while (expired != MASK_NONE) {
+        uint32_t idx = mask_last(expired);
+        expired &= ~MASK_BIT(idx);
+
+        _nbi_nbr_remove(nbi, idx);
+        _nbi_nbr_compact(nbi, idx);
+        ++n_expired;
+    }
+    nbi->wheel_window = window;
+    nbi->n_expired = n_expired;
+
+    return n_expired;
 err:
-    return INVALID_INDEX;
+    return 0;
 }
 
 /*! nbi_is_adj
@@ -357,274 +1292,634 @@ nbi_is_adj(
 {
     ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
 
+#ifdef NBI_ADJ_BITMAT
     return bm_is_set(nbi->adj, i, j);
+#else
+    return MASK_IS_SET(nbi->adj[i], j);
+#endif
 err:
     return 0;
 }
 
+/*! nbi_get_adj_row
+ *
+ * Everyone adjacent to i, as a mask over slots
+ */
+kb_mask_t
+nbi_get_adj_row(
+    nbrs_info_t *nbi,
+    uint32_t i)
+{
+    ASSERT_OR_ERR(nbi && i < nbi->max_nbrs, err, KB_ERR_INPUT);
+
+    return NBI_ADJ_ROW(nbi, i);
+err:
+    return MASK_NONE;
+}
+
+/*! nbi_get_degree
+ *
+ * Number of neighbors adjacent to i
+ */
+uint32_t
+nbi_get_degree(
+    nbrs_info_t *nbi,
+    uint32_t i)
+{
+    return mask_count(nbi_get_adj_row(nbi, i));
+}
+
+/*! _nbi_expand
+ *
+ * Breadth-first expansion from the nodes in visited, one frontier at a
+ * time. Each step ORs the adjacency rows of the frontier together, so
+ * a round costs one row fetch per frontier node.
+ *
+ * @param[in] visited   Nodes to start from
+ * @param[in] target    Stop as soon as any of these is reached
+ *
+ * @return Everything reached (including visited) when we stopped
+ */
+static kb_mask_t
+_nbi_expand(
+    nbrs_info_t *nbi,
+    kb_mask_t visited,
+    kb_mask_t target)
+{
+    kb_mask_t frontier = visited;
+    while (frontier != MASK_NONE && (visited & target) == MASK_NONE) {
+        kb_mask_t next = MASK_NONE;
+        while (frontier != MASK_NONE) {
+            uint32_t k = mask_first(frontier);
+            frontier &= frontier - 1;
+            next |= NBI_ADJ_ROW(nbi, k);
+        }
+
+        frontier = next & ~visited;
+        visited |= frontier;
+    }
+
+    return visited;
+}
+
 /*! nbi_is_connected
  *
  * Determine if i is connected to j by any known route.
- * Currently uses Depth-first search
+ * Frontier search over the adjacency rows, stopping as soon as j
+ * is reached
  */
 bool
 nbi_is_connected(
     nbrs_info_t *nbi,
     uint32_t i,
     uint32_t j)
+{
+    ASSERT_OR_ERR(nbi && i < nbi->n_nbrs && j < nbi->n_nbrs,
+            err, KB_ERR_INPUT);
+
+    return MASK_IS_SET(_nbi_expand(nbi, MASK_BIT(i), MASK_BIT(j)), j);
+err:
+    return false;
+}
+
+/*! nbi_reachable
+ *
+ * Every neighbor connected to i by some known route, including i
+ * itself, in a single search
+ */
+kb_mask_t
+nbi_reachable(
+    nbrs_info_t *nbi,
+    uint32_t i)
+{
+    ASSERT_OR_ERR(nbi && i < nbi->n_nbrs, err, KB_ERR_INPUT);
+
+    return _nbi_expand(nbi, MASK_BIT(i), MASK_NONE);
+err:
+    return MASK_NONE;
+}
+
+/*! nbi_segment_nbrs
+ *
+ * Segment neighbors into their disconnected components from scratch
+ * using the adjacency matrix. Components are normally kept current
+ * incrementally by nbi_set_adj/nbi_clr_adj, so this is only needed to
+ * resynchronize after editing adj directly.
+ */
+void
+nbi_segment_nbrs(nbrs_info_t *nbi)
 {
     ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
 
-    // objects to act as raw array for the resultant/temp bitmats
-    uint8_t _acc_raw[STATIC_SIZE_NBI_ADJ_DATA];
-    uint8_t _next_raw[STATIC_SIZE_NBI_ADJ_DATA];
+    _nbi_comp_resync(nbi);
+
+err:
+    return;
+}
 
-    // short circuit if they're trivially connected
+/*! nbi_set_adj
+ *
+ * Mark i and j adjacent
+ */
+void
+nbi_set_adj(
+        nbrs_info_t *nbi,
+        uint32_t i,
+        uint32_t j)
+{
+    ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
     if (nbi_is_adj(nbi, i, j)) {
-        return true;
+        return;
+    }
+    _nbi_adj_set(nbi, i, j);
+    _nbi_journal_edge(nbi, nbi->journal.edges_added,
+            &nbi->journal.n_edges_added, i, j);
+
+    // a new link can only ever join two components
+    if (_nbi_comp_union(nbi, i, j)) {
+        _nbi_comp_relabel(nbi);
     }
+err:
+    return;
+}
 
-    // accumulator matrix, statically allocated
-    bitmat_t acc;
-    bm_init(&acc, nbi->adj->n, 0, BM_SYMMETRIC,
-            _acc_raw, STATIC_SIZE_NBI_ADJ_DATA);
-    bm_copy(&acc, nbi->adj);
+/*! nbi_clr_adj
+ *
+ * Mark i and j nonadjacent
+ */
+void
+nbi_clr_adj(
+    nbrs_info_t *nbi,
+    uint32_t i,
+    uint32_t j)
+{
+    ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
+    if (!nbi_is_adj(nbi, i, j)) {
+        return;
+    }
+    _nbi_adj_clr(nbi, i, j);
+    _nbi_journal_edge(nbi, nbi->journal.edges_removed,
+            &nbi->journal.n_edges_removed, i, j);
 
-    bitmat_t next;
-    bm_init(&next, nbi->adj->n, 0, BM_SYMMETRIC,
-            _next_raw, STATIC_SIZE_NBI_ADJ_DATA);
+    // removing a link can split the component it was in, but no other
+    _nbi_comp_rebuild(nbi, _nbi_comp_find(nbi, i));
+err:
+    return;
+}
 
-    // Use properties of adjacency matrices
-    //
-    // 1. Nilpotent of order <= dimension
-    //
-    // 2. adj^k is the adj matrix of length-k paths
-    for (uint32_t k = 0; k < nbi_get_nnbrs(nbi); ++k)
-    {
-        // multiply the accumulated value
-        bm_mult(&acc, nbi->adj, &next);
-        bm_copy(&acc, &next);
+/*! nbi_get_dist
+ *
+ * Get the distance between neighbors i and j. If i == j 
+ * this returns the distance from this node to neighbor i
+ */
+kb_dist_t
+nbi_get_dist(
+    nbrs_info_t *nbi,
+    uint32_t i,
+    uint32_t j)
+{
+    ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
+    return matu16_get(nbi->pd, i, j);
+err:
+    return KB_DIST_INVALID;
+}
 
-        // if for some power k the two are adjacent,
-        // then the two are connected by a path of length k
-        if (bm_is_set(&acc, i, j)) {
-            return true;
-        }
+/*! nbi_get_dist_row
+ *
+ * Copy the distances from neighbor i to every neighbor into row, which
+ * must hold n_nbrs entries. row[i] is our own distance to i.
+ *
+ * @return Number of distances copied
+ */
+uint32_t
+nbi_get_dist_row(
+    nbrs_info_t *nbi,
+    uint32_t i,
+    kb_dist_t *row)
+{
+    ASSERT_OR_ERR(nbi && i < nbi->n_nbrs && row, err, KB_ERR_INPUT);
+    return matu16_get_row(nbi->pd, i, row, nbi->n_nbrs);
+err:
+    return 0;
+}
+
+/*! nbi_set_dist
+ *
+ * Update the distance from neighbor i to neighbor j. If i == j, this
+ * updates the distance from this node to neighbor i.
+ */
+void
+nbi_set_dist(
+    nbrs_info_t *nbi,
+    uint32_t i,
+    uint32_t j,
+    kb_dist_t dist)
+{
+    ASSERT_OR_ERR(nbi && i < nbi->max_nbrs && j < nbi->max_nbrs,
+            err, KB_ERR_INPUT);
+#ifdef NBI_DIST_AGE
+    nbi->dist_stamp[matu16_tri_idx(i, j)] = nbi->dist_clock;
+#endif
+    if (nbi_get_dist(nbi, i, j) == dist) {
+        return;
+    }
+    matu16_set(nbi->pd, i, j, dist);
+
+    // a change the current locations already account for (typically
+    // our own motion) leaves an up to date localization up to date
+    bool current = nbi->localized_gen == nbi->journal.gen;
+    bool predicted = _nbi_dist_predicted(nbi, i, j, dist);
+
+    nbi->journal.ranged |= MASK_BIT(i) | MASK_BIT(j);
+    ++nbi->journal.gen;
+
+    if (!predicted) {
+        nbi->loc_dirty |= MASK_BIT(i) | MASK_BIT(j);
+    } else if (current) {
+        nbi->localized_gen = nbi->journal.gen;
+    }
+err:
+    return;
+}
+
+/*! nbi_clr_dist
+ *
+ * Clears the distance from neighbor i to j.
+ */
+void
+nbi_clr_dist(
+    nbrs_info_t *nbi,
+    uint32_t i,
+    uint32_t j)
+{
+    ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
+    nbi_set_dist(nbi, i, j, KB_DIST_INVALID);
+err:
+    return;
+}
+
+/*! nbi_filter_dist
+ *
+ * Feed a raw distance sample for the pair (i, j) through its filter.
+ * The filter is an exponential moving average (only when built with
+ * NBI_DIST_EMA, otherwise samples are taken as they are); pd is only
+ * rewritten (and the change journaled) when the filtered value has
+ * moved at least NBI_DIST_HYST from what pd holds, so noise on a still
+ * pair doesn't churn everything downstream.
+ *
+ * @return true if pd was updated
+ */
+bool
+nbi_filter_dist(
+    nbrs_info_t *nbi,
+    uint32_t i,
+    uint32_t j,
+    kb_dist_t sample)
+{
+    ASSERT_OR_ERR(nbi && i < nbi->max_nbrs && j < nbi->max_nbrs,
+            err, KB_ERR_INPUT);
+
+    if (sample == KB_DIST_INVALID) {
+        return false;
+    }
+
+#ifdef NBI_DIST_AGE
+    // even a sample that doesn't move pd confirms it
+    nbi->dist_stamp[matu16_tri_idx(i, j)] = nbi->dist_clock;
+#endif
+
+#ifdef NBI_DIST_EMA
+    if (sample > NBI_DIST_FILTER_MAX) {
+        sample = NBI_DIST_FILTER_MAX;
+    }
+
+    uint16_t *ema = &nbi->dist_ema[matu16_tri_idx(i, j)];
+    uint16_t x = sample << NBI_DIST_FRAC_BITS;
+    if (*ema == NBI_DIST_EMA_EMPTY) {
+        *ema = x;
+    } else if (x > *ema) {
+        *ema += (x - *ema) >> NBI_DIST_EMA_SHIFT;
+    } else {
+        *ema -= (*ema - x) >> NBI_DIST_EMA_SHIFT;
+    }
+
+    // round back to whole units
+    kb_dist_t filt = (*ema + (0x1 << (NBI_DIST_FRAC_BITS - 1)))
+        >> NBI_DIST_FRAC_BITS;
+#else
+    kb_dist_t filt = sample;
+#endif
+    kb_dist_t cur = nbi_get_dist(nbi, i, j);
+    if (cur != KB_DIST_INVALID
+            && (filt > cur? filt - cur : cur - filt) < NBI_DIST_HYST)
+    {
+        return false;
     }
 
+    nbi_set_dist(nbi, i, j, filt);
+    return true;
 err:
     return false;
 }
 
-/*! nbi_segment_nbrs
+/*! nbi_get_dist_age
  *
- * Segment neighbors into their disconnected components using adjacency
- * matrix
+ * How long ago, on the distance age clock, (i, j) last got a sample.
+ * NBI_DIST_AGE_INVALID if there's no distance at all. Without
+ * NBI_DIST_AGE no ages are kept and every distance counts as fresh.
  */
-void
-nbi_segment_nbrs(nbrs_info_t *nbi)
+uint16_t
+nbi_get_dist_age(
+    nbrs_info_t *nbi,
+    uint32_t i,
+    uint32_t j)
 {
-    // objects to act as raw array for the resultant/temp bitmats
-    uint8_t _acc_raw[STATIC_SIZE_NBI_ADJ_DATA];
-    uint8_t _next_raw[STATIC_SIZE_NBI_ADJ_DATA];
-
-    ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
+    ASSERT_OR_ERR(nbi && i < nbi->max_nbrs && j < nbi->max_nbrs,
+            err, KB_ERR_INPUT);
 
-    uint32_t comps[MAX_NEIGHBORS];
+    if (nbi_get_dist(nbi, i, j) == KB_DIST_INVALID) {
+        return NBI_DIST_AGE_INVALID;
+    }
+#ifdef NBI_DIST_AGE
+    return nbi->dist_clock - nbi->dist_stamp[matu16_tri_idx(i, j)];
+#else
+    return 0;
+#endif
+err:
+    return NBI_DIST_AGE_INVALID;
+}
 
-    // accumulator matrix, statically allocated
-    bitmat_t acc;
-    bm_init(&acc, nbi->adj->n, 0, BM_SYMMETRIC,
-            _acc_raw, STATIC_SIZE_NBI_ADJ_DATA);
-    bm_copy(&acc, nbi->adj);
+/*! nbi_get_furthest_idx
+ *
+ * Get the index of the furthest neighbor
+ */
+nbr_t *
+nbi_get_furthest(nbrs_info_t *nbi)
+{
+    uint32_t furthest;
+    kb_dist_t tmp_dist;
+    kb_dist_t furthest_dist = 0.0f;
 
-    bitmat_t next;
-    bm_init(&next, nbi->adj->n, 0, BM_SYMMETRIC,
-            _next_raw, STATIC_SIZE_NBI_ADJ_DATA);
+    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
+        tmp_dist = nbi_get_dist(nbi, i, i);
 
-    uint32_t nnbrs = nbi_get_nnbrs(nbi);
-    for (uint32_t i = 0; i < nnbrs; ++i) {
-        // initially set components equal to themselves
-        comps[i] = i;
+        if (tmp_dist > furthest_dist) {
+            furthest = i;
+            furthest_dist = tmp_dist;
+        }
     }
 
-    //
-    // Use properties of adjacency matrices
-    //
-    // 1. adj^k is the adj matrix of length-k paths
-    //
-    for (uint32_t k = 0; k < nnbrs; ++k)
-    {
-        //
-        // prune components
-        //
-        // For each neighbor, set our value to the smallest index
-        // of neighbors that we're connected to
-        //
-        for (uint32_t i = 1; i < nnbrs; ++i) {
-            for (uint32_t j = 0; j < i; ++j) {
-                if (bm_is_set(&acc, i, j)) {
-                    if (j < comps[i]) {
-                        comps[i] = j;
-                    }
-                    // break because we only need to consider
-                    // the smallest for each round
-                    break;
-                }
-            }
-        }
+    return nbi_get_nbr(nbi, furthest);
+}
 
-        // multiply the accumulated value
-        bm_mult(&acc, nbi->adj, &next);
-        bm_copy(&acc, &next);
-        // clear the result array
-        bm_fill(&next, 0x0);
-    }
-
-    //
-    // setup components
-    //
-    // Anything in the list that still has its own index for a value
-    // is the smallest neighbor with a given component. For those we
-    // increase the number of components. Anything that doesn't
-    // have its own index for value is a neighbor which is connected
-    // to a neighbor of a smaller index through some chain, so since
-    // we set components in increasing index order, we can safely
-    // set their components to those already set for the smaller index.
-    //
-    uint32_t ncomps = 0;
-    for (uint32_t i = 0; i < nnbrs; ++i) {
-        if (comps[i] == i) {
-            // if we have too many components, we don't have enough information to compute anything
-            if (ncomps >= 5) {
-                nbi->nbrs[i].comp = NULL;
-                nbi->n_comps = 5;
-                return;
-            }
+/*! nbi_get_gen
+ *
+ * Current generation. Changes whenever anything in the table does.
+ */
+uint32_t
+nbi_get_gen(nbrs_info_t *nbi)
+{
+    ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
 
-            netcomp_t *comp = &nbi->comps[ncomps++];
-            // clear any prevous component info
-            netcomp_init(comp);
-            // add nbr i to the component
-            netcomp_update(nbi, comp, nbi_get_nbr(nbi, i));
+    return nbi->journal.gen;
+err:
+    return 0;
+}
 
-            nbi->nbrs[i].comp = comp;
-        } else {
-            nbi->nbrs[i].comp = nbi->nbrs[comps[i]].comp;
-        }
-    }
-    nbi->n_comps = ncomps;
+/*! nbi_journal_dirty
+ *
+ * Every slot that was added, evicted or re-ranged this tick
+ */
+kb_mask_t
+nbi_journal_dirty(nbrs_info_t *nbi)
+{
+    ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
 
+    return nbi->journal.added | nbi->journal.evicted | nbi->journal.ranged;
 err:
-    return;
+    return MASK_NONE;
 }
 
-/*! nbi_set_adj
+/*! nbi_journal_reset
  *
- * Mark i and j adjacent
+ * Start a new tick's journal. The generation counter carries over.
  */
 void
-nbi_set_adj(
-        nbrs_info_t *nbi,
-        uint32_t i,
-        uint32_t j)
+nbi_journal_reset(nbrs_info_t *nbi)
 {
     ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
-    if (nbi_is_adj(nbi, i, j)) {
-    }
-    bm_set(nbi->adj, i, j);
+
+    nbi->journal.added = MASK_NONE;
+    nbi->journal.evicted = MASK_NONE;
+    nbi->journal.ranged = MASK_NONE;
+    nbi->journal.flags = 0;
+    nbi->journal.n_edges_added = 0;
+    nbi->journal.n_edges_removed = 0;
 err:
     return;
 }
 
-/*! nbi_clr_adj
+/*! nbi_rx_push
  *
- * Mark i and j nonadjacent
+ * Stage a neighbor update from the rx callback. Only touches the ring
+ * and rx_head, so it is safe to call while the loop is working on the
+ * table. Pass KB_ID_INVALID as ohn_id for a bare id message.
+ *
+ * @return false if the ring was full and the update was dropped
  */
-void
-nbi_clr_adj(
+bool
+nbi_rx_push(
     nbrs_info_t *nbi,
-    uint32_t i,
-    uint32_t j)
+    kb_id_t id,
+    kb_dist_t dist,
+    kb_id_t ohn_id,
+    kb_dist_t ohn_dist)
 {
     ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
-    bm_clr(nbi->adj, i, j);
+
+    uint8_t head = nbi->rx_head;
+    uint8_t next = (head + 1) & (NBI_RX_RING_SIZE - 1);
+    if (next == nbi->rx_tail) {
+        ++nbi->rx_dropped;
+        return false;
+    }
+
+    nbi_rx_t *rx = &nbi->rx_ring[head];
+    rx->id = id;
+    rx->ohn_id = ohn_id;
+    rx->dist = dist;
+    rx->ohn_dist = ohn_dist;
+
+    // the entry has to be written out before it is published
+    NBI_BARRIER();
+    nbi->rx_head = next;
+
+    return true;
 err:
-    return;
+    return false;
 }
 
-/*! nbi_get_dist
+/*! nbi_rx_pop
  *
- * Get the distance between neighbors i and j. If i == j 
- * this returns the distance from this node to neighbor i
+ * Take the oldest staged update. Loop side only.
+ *
+ * @return false if nothing was staged
  */
-kb_dist_t
-nbi_get_dist(
+bool
+nbi_rx_pop(
     nbrs_info_t *nbi,
-    uint32_t i,
-    uint32_t j)
+    nbi_rx_t *rx)
 {
-    ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
-    return matf_get(nbi->pd, i, j);
+    ASSERT_OR_ERR(nbi && rx, err, KB_ERR_INPUT);
+
+    uint8_t tail = nbi->rx_tail;
+    if (tail == nbi->rx_head) {
+        return false;
+    }
+
+    // don't read the entry before we've seen it published
+    NBI_BARRIER();
+    *rx = nbi->rx_ring[tail];
+
+    // and don't hand the slot back until we're done reading it
+    NBI_BARRIER();
+    nbi->rx_tail = (tail + 1) & (NBI_RX_RING_SIZE - 1);
+
+    return true;
 err:
-    return KB_DIST_INVALID;
+    return false;
 }
 
-/*! nbi_set_dist
+/*! nbi_rx_apply
  *
- * Update the distance from neighbor i to neighbor j. If i == j, this
- * updates the distance from this node to neighbor i.
+ * Apply a batch of up to NBI_RX_BATCH_SIZE neighbor updates in order:
+ * every sender gets a slot (evicting if needed) and its range filtered
+ * in; for a reported one-hop neighbor, the link is added and that
+ * distance filtered in too, or it goes to the two-hop table if it
+ * isn't one of ours. Each id is looked up once.
+ *
+ * sum, if given, is filled in with what changed.
+ *
+ * @return Number of updates applied
  */
-void
-nbi_set_dist(
+uint32_t
+nbi_rx_apply(
     nbrs_info_t *nbi,
-    uint32_t i,
-    uint32_t j,
-    kb_dist_t dist)
+    const nbi_rx_t *rx,
+    uint32_t n,
+    kb_time_t ticks,
+    nbi_rx_sum_t *sum)
 {
-    ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
-    matf_set(nbi->pd, i, j, dist);
+    ASSERT_OR_ERR(nbi && rx && n <= NBI_RX_BATCH_SIZE, err, KB_ERR_INPUT);
+
+    nbi_rx_sum_t s = {0};
+    uint32_t n_applied = 0;
+    for (uint32_t k = 0; k < n; ++k) {
+        // refresh the sender, or give it a slot
+        uint32_t nbr_idx = nbi_get_nbr_idx(nbi, rx[k].id);
+        if (nbr_idx != INVALID_INDEX) {
+            _nbi_wheel_touch(nbi, nbr_idx, ticks, false);
+        } else {
+            nbr_idx = nbi_update_id(nbi, rx[k].id, ticks);
+            if (nbr_idx == INVALID_INDEX) {
+                continue;
+            }
+            s.news |= 1 << k;
+        }
+        s.applied |= 1 << k;
+        ++n_applied;
+
+        nbi_filter_dist(nbi, nbr_idx, nbr_idx, rx[k].dist);
+        s.ranged |= MASK_BIT(nbr_idx);
+
+        if (rx[k].ohn_id == KB_ID_INVALID) {
+            continue;
+        }
+
+        uint32_t ohn_idx = nbi_get_nbr_idx(nbi, rx[k].ohn_id);
+        if (ohn_idx != INVALID_INDEX) {
+            if (!nbi_is_adj(nbi, nbr_idx, ohn_idx)) {
+                nbi_set_adj(nbi, nbr_idx, ohn_idx);
+                nbi->last_new_ticks = ticks;
+                s.news |= 1 << k;
+                s.linked |= MASK_BIT(nbr_idx) | MASK_BIT(ohn_idx);
+            }
+            nbi_filter_dist(nbi, nbr_idx, ohn_idx, rx[k].ohn_dist);
+        } else if (rx[k].ohn_id != kilo_uid) {
+            // not a neighbor yet, hold on to it for when it is
+            nbi_two_hop_add(nbi, nbr_idx, rx[k].ohn_id, rx[k].ohn_dist,
+                    ticks);
+            ++s.n_two_hop;
+        }
+    }
+
+    if (sum) {
+        *sum = s;
+    }
+    return n_applied;
 err:
-    return;
+    return 0;
 }
 
-/*! nbi_clr_dist
+/*! nbi_two_hop_add
  *
- * Clears the distance from neighbor i to j.
+ * Remember that the neighbor in slot via_idx is dist from id, which
+ * isn't one of our neighbors. Refreshes the entry if we already have
+ * it, otherwise takes a free one or the least recently reported.
  */
 void
-nbi_clr_dist(
+nbi_two_hop_add(
     nbrs_info_t *nbi,
-    uint32_t i,
-    uint32_t j)
+    uint32_t via_idx,
+    kb_id_t id,
+    kb_dist_t dist,
+    kb_time_t ticks)
 {
-    ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
-    matf_set(nbi->pd, i, j, KB_DIST_INVALID);
+    ASSERT_OR_ERR(nbi && via_idx < nbi->n_nbrs && id != KB_ID_INVALID,
+            err, KB_ERR_INPUT);
+
+    kb_id_t via = NBI_NBR_ID(nbi, via_idx);
+    nbi_two_hop_t *slot = NULL;
+    for (uint32_t k = 0; k < NBI_TWO_HOP_SIZE; ++k) {
+        nbi_two_hop_t *th = &nbi->two_hop[k];
+        if (th->via == via && th->id == id) {
+            slot = th;
+            break;
+        }
+        if (!slot || (slot->via != KB_ID_INVALID
+                    && (th->via == KB_ID_INVALID
+                        || th->last_time < slot->last_time)))
+        {
+            slot = th;
+        }
+    }
+
+    slot->via = via;
+    slot->id = id;
+    slot->dist = dist;
+    slot->last_time = ticks;
 err:
     return;
 }
 
-/*! nbi_get_furthest_idx
+/*! nbi_two_hop_count
  *
- * Get the index of the furthest neighbor
+ * Number of two-hop entries in use
  */
-nbr_t *
-nbi_get_furthest(nbrs_info_t *nbi)
+uint32_t
+nbi_two_hop_count(nbrs_info_t *nbi)
 {
-    uint32_t furthest;
-    kb_dist_t tmp_dist;
-    kb_dist_t furthest_dist = 0.0f;
-
-    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
-        tmp_dist = nbi_get_dist(nbi, i, i);
+    ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
 
-        if (tmp_dist > furthest_dist) {
-            furthest = i;
-            furthest_dist = tmp_dist;
+    uint32_t count = 0;
+    for (uint32_t k = 0; k < NBI_TWO_HOP_SIZE; ++k) {
+        if (nbi->two_hop[k].via != KB_ID_INVALID) {
+            ++count;
         }
     }
-
-    return nbi_get_nbr(nbi, furthest);
+    return count;
+err:
+    return 0;
 }
 
 /*! nbi_flag_is_set
@@ -683,9 +1978,8 @@ nbi_nbr_flag_is_set(
     uint32_t idx,
     uint32_t flag)
 {
-    ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
-    nbr_t *n = nbi_get_nbr(nbi, idx);
-    return nbr_flag_is_set(n, flag);
+    ASSERT_OR_ERR(nbi && idx < nbi->n_nbrs, err, KB_ERR_INPUT);
+    return (NBI_NBR_FLAGS(nbi, idx) & flag) != 0;
 err:
     return false;
 }
@@ -700,9 +1994,12 @@ nbi_nbr_set_flag(
     uint32_t idx,
     uint32_t flag)
 {
-    ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
-    nbr_t *n = nbi_get_nbr(nbi, idx);
-    nbr_set_flag(n, flag);
+    ASSERT_OR_ERR(nbi && idx < nbi->n_nbrs, err, KB_ERR_INPUT);
+    NBI_NBR_FLAGS(nbi, idx) |= flag;
+    if (flag & NBR_LOCALIZED) {
+        nbi->localized |= MASK_BIT(idx);
+        _nbi_repulse_refresh(nbi, idx);
+    }
 err:
     return;
 }
@@ -717,13 +2014,52 @@ nbi_nbr_clr_flag(
     uint32_t idx,
     uint32_t flag)
 {
-    ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
-    nbr_t *n = nbi_get_nbr(nbi, idx);
-    nbr_clr_flag(n, flag);
+    ASSERT_OR_ERR(nbi && idx < nbi->n_nbrs, err, KB_ERR_INPUT);
+    NBI_NBR_FLAGS(nbi, idx) &= ~flag;
+    if (flag & NBR_LOCALIZED) {
+        nbi->localized &= ~MASK_BIT(idx);
+        _nbi_repulse_refresh(nbi, idx);
+    }
 err: 
     return;
 }
 
+/*! nbi_nbr_get_loc
+ *
+ * Get the component-local position of neighbor idx
+ */
+point_t
+nbi_nbr_get_loc(
+    nbrs_info_t *nbi,
+    uint32_t idx)
+{
+    point_t pt = {0,0};
+    ASSERT_OR_ERR(nbi && idx < nbi->n_nbrs, err, KB_ERR_INPUT);
+
+    return NBI_NBR_LOC(nbi, idx);
+err:
+    return pt;
+}
+
+/*! nbi_nbr_set_loc
+ *
+ * Move neighbor idx, remembering where it was before
+ */
+void
+nbi_nbr_set_loc(
+    nbrs_info_t *nbi,
+    uint32_t idx,
+    point_t loc)
+{
+    ASSERT_OR_ERR(nbi && idx < nbi->n_nbrs, err, KB_ERR_INPUT);
+
+    nbi->nbrs[idx].last_loc = NBI_NBR_LOC(nbi, idx);
+    NBI_NBR_LOC(nbi, idx) = loc;
+    _nbi_repulse_refresh(nbi, idx);
+err:
+    return;
+}
+
 /*! nbi_is_localized
  *
  * Check the NBI_LOCALIZED flag
@@ -787,14 +2123,136 @@ nbi_nbr_clr_localized(
     nbi_nbr_clr_flag(nbi, idx, NBR_LOCALIZED);
 }
 
+/*! _nbi_heading_find
+ *
+ * The component holding a localized neighbor in the heading's frame,
+ * NULL if there's none left
+ */
+static netcomp_t *
+_nbi_heading_find(nbrs_info_t *nbi)
+{
+    if (nbi->heading_frame != KB_ID_INVALID) {
+        kb_mask_t m = nbi->localized;
+        for (uint32_t i; (i = mask_pop(&m)) != INVALID_INDEX; ) {
+            if (nbi->nbrs[i].frame == nbi->heading_frame) {
+                return nbi->nbrs[i].comp;
+            }
+        }
+    }
+    return NULL;
+}
+
+/*! _nbi_heading_comp
+ *
+ * The component the heading is tracked in. If no localized neighbor is
+ * left in the heading's frame, the heading means nothing any more, so
+ * it starts over at 0 in the frame of the first component's anchor.
+ *
+ * Returns NULL if nothing is localized to track it against
+ */
+static netcomp_t *
+_nbi_heading_comp(nbrs_info_t *nbi)
+{
+    netcomp_t *comp = _nbi_heading_find(nbi);
+    if (comp) {
+        return comp;
+    }
+
+    nbi->heading = 0.0f;
+    nbi->heading_frame = KB_ID_INVALID;
+    if (nbi->n_comps == 0 || !nbi->comps[0].anchor) {
+        return NULL;
+    }
+
+    nbr_t *a = nbi->comps[0].anchor;
+    if (!MASK_IS_SET(nbi->localized, a->idx)) {
+        return NULL;
+    }
+    nbi->heading_frame = a->frame;
+    return &nbi->comps[0];
+}
+
+/*! nbi_odom_update
+ *
+ * Dead-reckon our own motion since the last update, taking action to
+ * have been in effect the whole time, and carry the neighborhood
+ * along with it: the heading turns, and every neighbor localized in
+ * the heading's frame shifts by the opposite of our translation.
+ * Frames stay centered on us but don't rotate with us.
+ *
+ * Other frames have no known relation to our heading, so there is no
+ * telling which way we moved in them. Their neighbors are marked for
+ * the next localization pass to place again instead.
+ */
+void
+nbi_odom_update(
+    nbrs_info_t *nbi,
+    uint8_t action,
+    kb_time_t ticks)
+{
+    ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
+
+    kb_time_t dt = ticks - nbi->odom_ticks;
+    nbi->odom_ticks = ticks;
+    _nbi_dist_clock_advance(nbi, dt, action != SA_STOP);
+    if (action == SA_STOP || action > SA_FWD_LEFT || dt == 0) {
+        return;
+    }
+
+    _nbi_heading_comp(nbi);
+
+    const float *rate = _nbi_odom_rates[action];
+    float fdt = (float)dt;
+    float dth = rate[1] * fdt;
+    float c, s;
+    kb_sincos(nbi->heading, &s, &c);
+
+    // straight (or arcing) motion goes along the average heading
+    float mid = nbi->heading + dth / 2;
+    point_t t;
+    kb_sincos(mid, &t.y, &t.x);
+    t.x *= rate[0] * fdt;
+    t.y *= rate[0] * fdt;
+
+    // pivoting swings our center around a leg: t = p - R(dth) p
+    if (rate[2] != 0.0f) {
+        point_t p = {-rate[2] * s, rate[2] * c};
+        float cd, sd;
+        kb_sincos(dth, &sd, &cd);
+        t.x += p.x - (cd * p.x - sd * p.y);
+        t.y += p.y - (sd * p.x + cd * p.y);
+    }
+
+    nbi->heading = center_angle(nbi->heading + dth);
+
+    kb_mask_t m = nbi->localized;
+    for (uint32_t i; (i = mask_pop(&m)) != INVALID_INDEX; ) {
+        if (nbi->heading_frame == KB_ID_INVALID
+                || nbi->nbrs[i].frame != nbi->heading_frame)
+        {
+            nbi->loc_dirty |= MASK_BIT(i);
+            continue;
+        }
+        point_t loc = NBI_NBR_LOC(nbi, i);
+        loc.x -= t.x;
+        loc.y -= t.y;
+        nbi_nbr_set_loc(nbi, i, loc);
+    }
+
+err:
+    return;
+}
+
 /*! nbi_guess_orientation
  *
  * Guess the current orientation of the robot
  * relative to the current neighbor information,
  * given that since the last timestep action has been
- * taken
+ * taken. In the heading's frame, as nbi_repulsion_vec.
  *
- * TODO: implement
+ * Only a query: the loop's nbi_odom_update has already applied action
+ * up to this tick. If the heading's frame is gone, this is the 0 it
+ * would start over at.
  */
 float
 nbi_guess_orientation(
@@ -802,6 +2260,9 @@ nbi_guess_orientation(
     uint8_t action)
 {
     ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
+    (void)action;
+
+    return _nbi_heading_find(nbi)? nbi->heading : 0.0f;
 
 err:
     return 0.0f;
@@ -812,6 +2273,13 @@ err:
  * Compute a repulsion vector as a weighted sum over the neighbors
  * in each component, with some informed guess as to the relationship
  * between components
+ *
+ * The per-component sums are maintained as neighbors move, so this
+ * only has to combine n_comps vectors. The result is in the heading's
+ * frame (the first component's if there is no heading yet). The other
+ * components have unknown bearing, so they are spread evenly around the
+ * arc that one leaves uncovered, each rotated so its most cw neighbor
+ * lands at its slot.
  */
 point_t
 nbi_repulsion_vec(nbrs_info_t *nbi)
@@ -819,6 +2287,42 @@ nbi_repulsion_vec(nbrs_info_t *nbi)
     point_t pt = {0,0};
     ASSERT_OR_ERR(nbi, err, KB_ERR_INPUT);
 
+    if (nbi->n_comps == 0) {
+        goto err;
+    }
+
+    netcomp_t *base = _nbi_heading_comp(nbi);
+    if (!base) {
+        base = &nbi->comps[0];
+    }
+    pt = base->repulse;
+
+    // room left over once every other component takes its coverage
+    float others = 0.0f;
+    for (uint32_t i = 0; i < nbi->n_comps; ++i) {
+        if (&nbi->comps[i] != base) {
+            others += nbi->comps[i].coverage;
+        }
+    }
+    float gap = TWO_PI - base->coverage - others;
+    float spacing = (gap > 0.0f) ? gap / nbi->n_comps : 0.0f;
+
+    float at = base->start_angle + base->coverage + spacing;
+    for (uint32_t i = 0; i < nbi->n_comps; ++i) {
+        netcomp_t *comp = &nbi->comps[i];
+        if (comp == base) {
+            continue;
+        }
+        float rot = at - comp->start_angle;
+        float c, s;
+        kb_sincos(rot, &s, &c);
+        pt.x += c * comp->repulse.x - s * comp->repulse.y;
+        pt.y += s * comp->repulse.x + c * comp->repulse.y;
+        at += comp->coverage + spacing;
+    }
+
+    nbi->repulse = pt;
+
 err:
     return pt;
 }
@@ -839,30 +2343,44 @@ nbi_print(nbrs_info_t *nbi, char* pref)
     printf("%snbi: %p\n", pref, nbi);
     printf("%s\tn_nbrs: %d\n", pref, nbi->n_nbrs);
     printf("%s\tmax_nbrs: %d\n", pref, nbi->max_nbrs);
-    printf("%s\tpol: ", pref);
-    switch (nbi->pol) {
-        case POL_EVICT_OLDEST:
-            printf("evict_oldest");
-            break;
-
-        default:
-            printf("unknown");
-    }
-    printf("\n");
+    evict_pol_t *pol = evict_get_pol(nbi->pol);
+    printf("%s\tpol: %s\n", pref, pol? pol->name: "unknown");
     printf("%s\tflags: 0x%x\n", pref, nbi->flags);
+    printf("%s\tgen: %u\n", pref, nbi->journal.gen);
+    printf("%s\tloc: %u run, %u skipped\n", pref, nbi->loc_runs, nbi->loc_skips);
+    printf("%s\theading: %0.2f in %x\n", pref, nbi->heading, nbi->heading_frame);
+    printf("%s\ttwo_hop: %u\n", pref, nbi_two_hop_count(nbi));
 
     printf("%s\tnbrs[%d]: %p\n", pref, nbi->n_nbrs, nbi->nbrs);
     for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
         nbr_print(&nbi->nbrs[i], next_pref);
+#ifdef NBI_SOA
+        printf("%s\tid: %x\n", next_pref, NBI_NBR_ID(nbi, i));
+        printf("%s\tlast_time: %d\n", next_pref, NBI_NBR_LAST_TIME(nbi, i));
+        printf("%s\tflags: %x\n", next_pref, NBI_NBR_FLAGS(nbi, i));
+        printf("%s\tloc: (%0.2f, %0.2f)\n", next_pref,
+                NBI_NBR_LOC(nbi, i).x, NBI_NBR_LOC(nbi, i).y);
+#endif
     }
     printf("\n");
 
     printf("%s\tpd: %p\n", pref, nbi->pd);
-    matf_print(nbi->pd, next_pref);
+    matu16_print(nbi->pd, next_pref);
     printf("\n");
 
+#ifdef NBI_ADJ_BITMAT
     printf("%s\tadj: %p\n", pref, nbi->adj);
     bm_print(nbi->adj, next_pref);
+#else
+    printf("%s\tadj:\n", pref);
+    for (uint32_t i = 0; i < nbi->max_nbrs; ++i) {
+        printf("%s", next_pref);
+        for (uint32_t j = 0; j < nbi->max_nbrs; ++j) {
+            printf("%s", (MASK_IS_SET(nbi->adj[i], j)? "1": "0"));
+        }
+        printf("\n");
+    }
+#endif
     printf("\n");
 
     printf("%s\tcomps[%d]:\n", pref, nbi->n_comps);
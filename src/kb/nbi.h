@@ -3,10 +3,167 @@
 
 #include "constants.h"
 #include "types.h"
-#include "matf.h"
+#include "matu16.h"
 #include "bitarray.h"
+#include "mask.h"
 #include "nbr.h"
 #include "netcomp.h"
+#include "evict.h"
+
+/*! nbi_edge_t
+ *
+ * An adjacency edge between two neighbor slots
+ */
+typedef struct nbi_edge_t {
+    uint8_t i, j;
+} nbi_edge_t;
+
+/*! nbi_rx_t
+ *
+ * Neighbor update heard in the rx callback, staged until the loop
+ * applies it
+ */
+typedef struct nbi_rx_t {
+    /*! id
+     *
+     * Sender of the message
+     */
+    kb_id_t id;
+
+    /*! ohn_id
+     *
+     * One-hop neighbor the sender reported, KB_ID_INVALID if none
+     */
+    kb_id_t ohn_id;
+
+    /*! dist
+     *
+     * Our measured distance to the sender
+     */
+    kb_dist_t dist;
+
+    /*! ohn_dist
+     *
+     * Sender's distance to ohn_id
+     */
+    kb_dist_t ohn_dist;
+} nbi_rx_t;
+
+/*! nbi_rx_sum_t
+ *
+ * What applying a batch of neighbor updates changed. Bit k of applied
+ * and news refers to the k-th update of the batch.
+ */
+typedef struct nbi_rx_sum_t {
+    /*! applied
+     *
+     * Updates whose sender has (or got) a slot. The rest were dropped
+     */
+    uint8_t applied;
+
+    /*! news
+     *
+     * Updates that brought in a new neighbor or a new link
+     */
+    uint8_t news;
+
+    /*! n_two_hop
+     *
+     * Updates handed to the two-hop table
+     */
+    uint8_t n_two_hop;
+
+    /*! ranged, linked
+     *
+     * Slots that got a distance sample, and slots that got a new link
+     */
+    kb_mask_t ranged;
+    kb_mask_t linked;
+} nbi_rx_sum_t;
+
+/*! nbi_two_hop_t
+ *
+ * Distance a neighbor reported to a robot that isn't our neighbor
+ * (yet)
+ */
+typedef struct nbi_two_hop_t {
+    /*! via
+     *
+     * Neighbor that reported it, KB_ID_INVALID if the entry is free
+     */
+    kb_id_t via;
+
+    /*! id
+     *
+     * Robot two hops away
+     */
+    kb_id_t id;
+
+    /*! dist
+     *
+     * via's distance to id
+     */
+    kb_dist_t dist;
+
+    /*! last_time
+     *
+     * Time the entry was last reported
+     */
+    kb_time_t last_time;
+} nbi_two_hop_t;
+
+/*! nbi_journal_t
+ *
+ * Record of what changed in the neighbor table since the journal was
+ * last reset (once per loop tick)
+ */
+typedef struct nbi_journal_t {
+    /*! gen
+     *
+     * Generation counter, bumped on every recorded change. Never reset,
+     * so readers can remember it and check whether anything moved.
+     */
+    uint32_t gen;
+
+    /*! added, evicted, ranged
+     *
+     * Slots that got a new neighbor, lost their neighbor, or had a
+     * distance to/from them change. Links lost with an evicted
+     * neighbor are covered by evicted rather than listed as edges.
+     */
+    kb_mask_t added;
+    kb_mask_t evicted;
+    kb_mask_t ranged;
+
+#define NBI_JOURNAL_OVERFLOW    0x1
+
+    /*! flags
+     *
+     * NBI_JOURNAL_OVERFLOW if an edge list filled up. Readers should
+     * then treat every edge as changed.
+     */
+    uint8_t flags;
+
+    /*! n_edges_added, n_edges_removed
+     *
+     * Number of valid entries in the edge lists
+     */
+    uint8_t n_edges_added;
+    uint8_t n_edges_removed;
+
+    /*! rsvd
+     *
+     * Explicit padding
+     */
+    uint8_t rsvd;
+
+    /*! edges_added, edges_removed
+     *
+     * Links that appeared/disappeared, in order
+     */
+    nbi_edge_t edges_added[NBI_JOURNAL_EDGES];
+    nbi_edge_t edges_removed[NBI_JOURNAL_EDGES];
+} nbi_journal_t;
 
 /*! nbrs_info_t
  *
@@ -15,7 +172,8 @@
 typedef struct nbrs_info_t {
     /*! n_nbrs
      *
-     * Size of nbr info array (number of current nbrs)
+     * Size of nbr info array (number of current nbrs). Live neighbors
+     * always occupy slots [0, n_nbrs).
      */
     uint32_t n_nbrs;
 
@@ -25,15 +183,15 @@ typedef struct nbrs_info_t {
      */
     uint32_t max_nbrs;
 
-#define POL_EVICT_OLDEST    0x1
-
     /*! pol
      *
-     * Eviction policy.
+     * Eviction policy, one of the POL_EVICT_* entries in the evict
+     * policy table
      */
     uint8_t pol;
 
 #define NBI_LOCALIZED        0x1
+#define NBI_LOC_DEMAND       0x2
 
     /*! flags
      *
@@ -55,7 +213,8 @@ typedef struct nbrs_info_t {
 
     /*! repulse
      *
-     * Repulsion vector from last time we localized the whole neighborhood
+     * Repulsion vector from the last call to nbi_repulsion_vec, in the
+     * heading's frame
      */
     point_t repulse;
 
@@ -65,28 +224,200 @@ typedef struct nbrs_info_t {
      */
     nbr_t *nbrs;
 
+#ifdef NBI_SOA
+    /*! nbr_id, nbr_last_time, nbr_flags, nbr_loc
+     *
+     * Structure-of-arrays storage for the nbr_t fields the hot scans
+     * touch, so each scan walks one contiguous array. Only present
+     * when built with NBI_SOA; use the NBI_NBR_* accessors.
+     */
+    kb_id_t nbr_id[MAX_NEIGHBORS];
+    kb_time_t nbr_last_time[MAX_NEIGHBORS];
+    uint8_t nbr_flags[MAX_NEIGHBORS];
+    point_t nbr_loc[MAX_NEIGHBORS];
+#endif
+
+#define NBI_ID_INDEX_EMPTY  0xff
+
+    /*! id_index
+     *
+     * Open-addressed (linear probing) index from neighbor id to its
+     * slot in nbrs. Holds only slots, the key is read back out of nbrs.
+     * Empty entries are NBI_ID_INDEX_EMPTY.
+     */
+    uint8_t id_index[NBI_ID_INDEX_SIZE];
+
     /*! pd
      *
-     * pairwise distance array
+     * pairwise distance array, kept as kb_dist_t
      * 
      * size given by 0.5*n_sz(n_sz + 1)
      */
-    matf_t *pd;
+    matu16_t *pd;
 
+#ifdef NBI_ADJ_BITMAT
     /*! adj
      *
      * One-hop nbr bit matrix
      *
-     * size given by ceil(0.5*n_sz(n_sz+1) / 8)
+     * size given by ceil(n_sz*n_sz / 8)
      */
     bitmat_t *adj;
+#else
+    /*! adj
+     *
+     * One-hop nbr adjacency, one word per row: j is adjacent to i
+     * iff bit j of adj[i] is set. Kept symmetric.
+     */
+    kb_mask_t adj[MAX_NEIGHBORS];
+#endif
+
+    /*! localized
+     *
+     * Slots with NBR_LOCALIZED set, kept in step with the flags so
+     * queries can work on whole words
+     */
+    kb_mask_t localized;
+
+    /*! loc_dirty
+     *
+     * Slots whose location can't be trusted any more: the neighbor is
+     * new, or a distance to it changed in a way its location doesn't
+     * explain. Cleared by every localization pass.
+     */
+    kb_mask_t loc_dirty;
+
+#define NBI_DIST_EMA_EMPTY  0xffff
+#define NBI_DIST_FILTER_MAX ((NBI_DIST_EMA_EMPTY >> NBI_DIST_FRAC_BITS) - 1)
+
+#ifdef NBI_DIST_EMA
+    /*! dist_ema
+     *
+     * Filtered distance samples, same pairs as pd, in fixed point with
+     * NBI_DIST_FRAC_BITS fractional bits. NBI_DIST_EMA_EMPTY until a
+     * pair gets its first sample. Only present when built with
+     * NBI_DIST_EMA.
+     */
+    uint16_t dist_ema[PAIRWISE_DIST_ARR_SIZE];
+#endif
+
+#define NBI_DIST_AGE_INVALID    0xffff
+
+    /*! dist_stamp, dist_clock
+     *
+     * dist_clock value when each pd entry last got a sample. The clock
+     * follows elapsed ticks, NBI_DIST_AGE_MOVING times faster while we
+     * move, so dist_clock - dist_stamp is how much to doubt an entry.
+     * The stamps are only kept when built with NBI_DIST_AGE.
+     */
+#ifdef NBI_DIST_AGE
+    uint16_t dist_stamp[PAIRWISE_DIST_ARR_SIZE];
+#endif
+    uint16_t dist_clock;
+
+    /*! comp_parent
+     *
+     * Union-find forest over neighbor slots. The root of every tree is
+     * the smallest index in its component. Kept current as adjacency
+     * changes, so components never have to be recomputed per tick.
+     */
+    uint8_t comp_parent[MAX_NEIGHBORS];
+
+    /*! wheel
+     *
+     * Timing wheel of neighbors by when we last heard from them. Bucket
+     * k holds the slots last heard during a window of NBI_WHEEL_WIDTH
+     * ticks congruent to k. One spare bucket so a bucket is never
+     * reused before everything in it has timed out.
+     */
+    kb_mask_t wheel[NBI_WHEEL_SLOTS + 1];
+
+    /*! wheel_window
+     *
+     * Last window (ticks / NBI_WHEEL_WIDTH) the wheel was advanced to
+     */
+    kb_time_t wheel_window;
+
+    /*! n_expired
+     *
+     * Number of neighbors that timed out on the last call to
+     * nbi_expire_nbrs
+     */
+    uint32_t n_expired;
+
+    /*! journal
+     *
+     * Changes since the start of this tick, and the generation counter
+     */
+    nbi_journal_t journal;
+
+    /*! localized_gen
+     *
+     * Journal generation the last complete localization was run at
+     */
+    uint32_t localized_gen;
+
+    /*! loc_ticks, loc_runs, loc_skips
+     *
+     * When the localization schedule last came due, and how many
+     * times a pass has run or the loop has gone by without one
+     */
+    kb_time_t loc_ticks;
+    uint32_t loc_runs;
+    uint32_t loc_skips;
+
+    /*! heading, heading_frame
+     *
+     * Our heading as tracked by odometry, and the frame (see
+     * nbr_t::frame) it is tracked in. Starts over at 0 in the first
+     * component's frame whenever its own frame has no localized
+     * neighbors left; KB_ID_INVALID until there is one.
+     */
+    float heading;
+    kb_id_t heading_frame;
+
+    /*! odom_ticks
+     *
+     * Time up to which our own motion has been applied to the stored
+     * neighbor locations
+     */
+    kb_time_t odom_ticks;
+
+    /*! rx_ring
+     *
+     * Updates staged by the rx callback. Single producer (rx pushes at
+     * rx_head) and single consumer (the loop pops at rx_tail), so the
+     * rx path never touches the table itself and never waits.
+     */
+    nbi_rx_t rx_ring[NBI_RX_RING_SIZE];
+
+    /*! rx_head, rx_tail
+     *
+     * Ring indices. Each is only ever written by its own side.
+     */
+    volatile uint8_t rx_head;
+    volatile uint8_t rx_tail;
+
+    /*! rx_dropped
+     *
+     * Updates the rx side had to drop because the ring was full
+     */
+    uint16_t rx_dropped;
+
+    /*! two_hop
+     *
+     * Gossip about robots we haven't heard from directly. Promoted into
+     * pd and adj as soon as one becomes a neighbor, so its links are
+     * known without waiting for them to be gossiped again.
+     */
+    nbi_two_hop_t two_hop[NBI_TWO_HOP_SIZE];
 
     /*! comps
      *
      * Component array. Keeps track of disconnected components as
      * nbrs are added.
      */
-    netcomp_t comps[5];
+    netcomp_t comps[NBI_MAX_COMPS];
 
     /*! n_comps
      *
@@ -96,12 +427,45 @@ typedef struct nbrs_info_t {
     uint32_t n_comps;
 } nbrs_info_t;
 
+/*! NBI_NBR_*
+ *
+ * Lvalue accessors for the per-neighbor fields that are stored either
+ * in nbr_t (default) or in parallel arrays (NBI_SOA). No bounds checks.
+ */
+#ifdef NBI_SOA
+#define NBI_NBR_ID(nbi, i)          ((nbi)->nbr_id[(i)])
+#define NBI_NBR_LAST_TIME(nbi, i)   ((nbi)->nbr_last_time[(i)])
+#define NBI_NBR_FLAGS(nbi, i)       ((nbi)->nbr_flags[(i)])
+#define NBI_NBR_LOC(nbi, i)         ((nbi)->nbr_loc[(i)])
+#else
+#define NBI_NBR_ID(nbi, i)          ((nbi)->nbrs[(i)].id)
+#define NBI_NBR_LAST_TIME(nbi, i)   ((nbi)->nbrs[(i)].last_time)
+#define NBI_NBR_FLAGS(nbi, i)       ((nbi)->nbrs[(i)].flags)
+#define NBI_NBR_LOC(nbi, i)         ((nbi)->nbrs[(i)].loc)
+#endif
+
+/*! NBI_ADJ_ROW
+ *
+ * Adjacency row of slot i as a mask, column j in bit j
+ */
+#ifdef NBI_ADJ_BITMAT
+#define NBI_ADJ_ROW(nbi, i)         ((kb_mask_t)bm_get_row((nbi)->adj, (i)))
+#else
+#define NBI_ADJ_ROW(nbi, i)         ((nbi)->adj[(i)])
+#endif
+
 // Constructors/Destructors
 nbrs_info_t *nbi_create(uint32_t max_nbrs, uint8_t *raw, uint8_t pol);
+#ifdef NBI_ADJ_BITMAT
 void nbi_init(nbrs_info_t *nbi, uint32_t max_nbrs, uint8_t pol,
               nbr_t *nbrs, uint32_t nbrs_sz,
-              matf_t *pd, float *pd_data, uint32_t pd_data_sz,
+              matu16_t *pd, uint16_t *pd_data, uint32_t pd_data_sz,
               bitmat_t *adj, uint8_t *adj_data, uint32_t adj_data_sz);
+#else
+void nbi_init(nbrs_info_t *nbi, uint32_t max_nbrs, uint8_t pol,
+              nbr_t *nbrs, uint32_t nbrs_sz,
+              matu16_t *pd, uint16_t *pd_data, uint32_t pd_data_sz);
+#endif
 void nbi_clean(nbrs_info_t *nbi);
 void nbi_delete(nbrs_info_t *nbi);
 
@@ -110,27 +474,56 @@ nbr_t *nbi_get_nbr(nbrs_info_t *nbi, uint32_t idx);
 nbr_t *nbi_get_nbr_by_id(nbrs_info_t *nbi, kb_id_t id);
 uint32_t nbi_get_nbr_idx(nbrs_info_t *nbi, kb_id_t id);
 uint32_t nbi_update_id(nbrs_info_t *nbi, kb_id_t id, kb_time_t ticks);
+#ifndef NBI_SOA
 uint32_t nbi_add_nbr(nbrs_info_t *nbi, nbr_t *nbr);
+#endif
 bool nbi_nbr_exists(nbrs_info_t *nbi, uint32_t idx);
 uint32_t nbi_find_nbr(nbrs_info_t *nbi, uint32_t nbr_i, uint32_t st, uint8_t cond);
+kb_mask_t nbi_get_flag_mask(nbrs_info_t *nbi, uint8_t cond);
+kb_mask_t nbi_query_nbrs(nbrs_info_t *nbi, uint32_t nbr_i, uint8_t cond);
 uint32_t nbi_get_nnbrs(nbrs_info_t *nbi);
 
 // Eviction function
 uint32_t nbi_evict_nbr(nbrs_info_t *nbi);
+uint32_t nbi_expire_nbrs(nbrs_info_t *nbi, kb_time_t ticks);
 
 // Adjacency functions
 bool nbi_is_adj(nbrs_info_t *nbi, uint32_t i, uint32_t j);
+kb_mask_t nbi_get_adj_row(nbrs_info_t *nbi, uint32_t i);
+uint32_t nbi_get_degree(nbrs_info_t *nbi, uint32_t i);
 void nbi_set_adj(nbrs_info_t *nbi, uint32_t i, uint32_t j);
 void nbi_clr_adj(nbrs_info_t *nbi, uint32_t i, uint32_t j);
 bool nbi_is_connected(nbrs_info_t *nbi, uint32_t i, uint32_t j);
+kb_mask_t nbi_reachable(nbrs_info_t *nbi, uint32_t i);
 void nbi_segment_nbrs(nbrs_info_t *nbi);
 
 // Distance functions
 kb_dist_t nbi_get_dist(nbrs_info_t *nbi, uint32_t i, uint32_t j);
+uint32_t nbi_get_dist_row(nbrs_info_t *nbi, uint32_t i, kb_dist_t *row);
 void nbi_set_dist(nbrs_info_t *nbi, uint32_t i, uint32_t j, kb_dist_t dist);
 void nbi_clr_dist(nbrs_info_t *nbi, uint32_t i, uint32_t j);
+bool nbi_filter_dist(nbrs_info_t *nbi, uint32_t i, uint32_t j,
+                     kb_dist_t sample);
+uint16_t nbi_get_dist_age(nbrs_info_t *nbi, uint32_t i, uint32_t j);
 nbr_t *nbi_get_furthest(nbrs_info_t *nbi);
 
+// Change journal
+uint32_t nbi_get_gen(nbrs_info_t *nbi);
+kb_mask_t nbi_journal_dirty(nbrs_info_t *nbi);
+void nbi_journal_reset(nbrs_info_t *nbi);
+
+// Staging between the rx callback and the loop
+bool nbi_rx_push(nbrs_info_t *nbi, kb_id_t id, kb_dist_t dist,
+                 kb_id_t ohn_id, kb_dist_t ohn_dist);
+bool nbi_rx_pop(nbrs_info_t *nbi, nbi_rx_t *rx);
+uint32_t nbi_rx_apply(nbrs_info_t *nbi, const nbi_rx_t *rx, uint32_t n,
+                      kb_time_t ticks, nbi_rx_sum_t *sum);
+
+// Two-hop neighbors
+void nbi_two_hop_add(nbrs_info_t *nbi, uint32_t via_idx, kb_id_t id,
+                     kb_dist_t dist, kb_time_t ticks);
+uint32_t nbi_two_hop_count(nbrs_info_t *nbi);
+
 // Check/manipulate flag functions
 bool nbi_flag_is_set(nbrs_info_t *nbi, uint32_t flag);
 void nbi_set_flag(nbrs_info_t *nbi, uint32_t flag);
@@ -139,6 +532,10 @@ bool nbi_nbr_flag_is_set(nbrs_info_t *nbi, uint32_t idx, uint32_t flag);
 void nbi_nbr_set_flag(nbrs_info_t *nbi, uint32_t idx, uint32_t flag);
 void nbi_nbr_clr_flag(nbrs_info_t *nbi, uint32_t idx, uint32_t flag);
 
+// Location functions
+point_t nbi_nbr_get_loc(nbrs_info_t *nbi, uint32_t idx);
+void nbi_nbr_set_loc(nbrs_info_t *nbi, uint32_t idx, point_t loc);
+
 // Specific flag functions
 bool nbi_is_localized(nbrs_info_t *nbi);
 bool nbi_nbr_is_localized(nbrs_info_t *nbi, uint32_t idx);
@@ -146,6 +543,7 @@ void nbi_nbr_set_localized(nbrs_info_t *nbi, uint32_t idx);
 void nbi_nbr_clr_localized(nbrs_info_t *nbi, uint32_t idx);
 
 // Orientation
+void nbi_odom_update(nbrs_info_t *nbi, uint8_t action, kb_time_t ticks);
 float nbi_guess_orientation(nbrs_info_t *nbi, uint8_t action);
 
 // Flocking functions
@@ -34,11 +34,22 @@ nbr_init(
 {
     ASSERT_OR_ERR(n, err, KB_ERR_INPUT);
 
+#ifndef NBI_SOA
     n->id = id;
     n->last_time = kilo_ticks;
     n->flags = 0;
     n->loc.x = 0.0f;
     n->loc.y = 0.0f;
+#else
+    // the id lives in nbi->nbr_id, set by the table
+    (void)id;
+#endif
+    n->refs[0] = NBR_REF_NONE;
+    n->refs[1] = NBR_REF_NONE;
+    n->frame = KB_ID_INVALID;
+    n->loc_stamp = 0;
+    n->repulse.x = 0.0f;
+    n->repulse.y = 0.0f;
     n->comp = NULL;
 
 err:
@@ -66,6 +77,7 @@ nbr_delete(nbr_t *n)
     free(n);
 }
 
+#ifndef NBI_SOA
 /*! nbr_flag_is_set
  *
  * Check if the flag is set
@@ -143,6 +155,7 @@ nbr_clr_localized(nbr_t *n)
 {
     nbr_clr_flag(n, NBR_LOCALIZED);
 }
+#endif
 
 /*! nbr_print
  *
@@ -154,13 +167,22 @@ nbr_print(nbr_t *n, char *pref)
     ASSERT_OR_ERR(n && pref, err, KB_ERR_INPUT);
 
     printf("%snbr: %p\n", pref, n);
+#ifndef NBI_SOA
     printf("%s\tid: %x\n", pref, n->id);
+#endif
     printf("%s\tidx: %d\n", pref, n->idx);
+#ifndef NBI_SOA
     printf("%s\tlast_time: %d\n", pref, n->last_time);
     printf("%s\tflags: %x\n", pref, n->flags);
+#endif
     printf("%s\thopct: %d\n", pref, n->hopct);
+    printf("%s\trefs: (%d, %d)\n", pref, n->refs[0], n->refs[1]);
+    printf("%s\tframe: %x\n", pref, n->frame);
+#ifndef NBI_SOA
     printf("%s\tloc: (%0.2f, %0.2f)\n", pref, n->loc.x, n->loc.y);
+#endif
     printf("%s\tlast_loc: (%0.2f, %0.2f)\n", pref, n->last_loc.x, n->last_loc.y);
+    printf("%s\trepulse: (%0.4f, %0.4f)\n", pref, n->repulse.x, n->repulse.y);
     printf("%s\tcomponent: %p\n", pref, n->comp);
 
 err:
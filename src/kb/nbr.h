@@ -10,14 +10,20 @@ typedef struct netcomp_t netcomp_t;
 /*! nbr_t
  *
  * Type used to keep track of most info for a single neighbor
+ *
+ * When built with NBI_SOA, the fields the hot scans touch (id,
+ * last_time, flags, loc) live in parallel arrays in nbrs_info_t
+ * instead, and must be reached through the NBI_NBR_* accessors.
  */
 typedef struct nbr_t {
+#ifndef NBI_SOA
     /*! id
      *
      * Universal id of the neighbor used to distinguish
      * from other neighbors
      */
     kb_id_t id;
+#endif
 
     /*! idx
      *
@@ -26,20 +32,24 @@ typedef struct nbr_t {
      */
     uint32_t idx;
 
+#ifndef NBI_SOA
     /*! last_time
      *
      * Time (ticks) that we last received a message from them.
      * Used primarily for eviction policy.
      */
     kb_time_t last_time;
+#endif
 
 #define NBR_LOCALIZED 0x1
 
+#ifndef NBI_SOA
     /*! flags
      *
      * Various flags
      */
     uint8_t flags;
+#endif
 
     /*! hopct
      *
@@ -47,23 +57,50 @@ typedef struct nbr_t {
      */
     uint8_t hopct;
 
-    /*! rsvd
+#define NBR_REF_NONE 0xff
+
+    /*! refs
+     *
+     * Indices of the neighbors this one was localized from, or
+     * NBR_REF_NONE. Used to tell which neighbors anchor others.
+     */
+    uint8_t refs[2];
+
+    /*! frame
      *
-     * Explicit padding
+     * Id of the neighbor placed on the x-axis of the frame this one
+     * was localized in. A neighbor whose frame is its own id is the
+     * root of that frame.
      */
-    uint8_t rsvd[2];
+    kb_id_t frame;
 
+    /*! loc_stamp
+     *
+     * nbrs_info_t::dist_clock when loc was last computed from
+     * distances rather than carried along by odometry
+     */
+    uint16_t loc_stamp;
+
+#ifndef NBI_SOA
     /*! loc
      *
      * Assigned position in component-local coordinate system
      */
     point_t loc;
+#endif
 
     /*! last_loc
      *
      * Assigned position in component-local coordinate system
      */
     point_t last_loc;
+
+    /*! repulse
+     *
+     * This neighbor's current term in its component's repulsion sum.
+     * Zero while the neighbor is not localized.
+     */
+    point_t repulse;
     
     /*! comp
      *
@@ -78,6 +115,7 @@ void nbr_init(nbr_t *n, kb_id_t id);
 void nbr_clean(nbr_t *n);
 void nbr_delete(nbr_t *n);
 
+#ifndef NBI_SOA
 // Check/manipulate flag functions
 bool nbr_flag_is_set(nbr_t *n, uint32_t flag);
 void nbr_set_flag(nbr_t *n, uint32_t flag);
@@ -87,6 +125,7 @@ void nbr_clr_flag(nbr_t *n, uint32_t flag);
 bool nbr_is_localized(nbr_t *n);
 void nbr_set_localized(nbr_t *n);
 void nbr_clr_localized(nbr_t *n);
+#endif
 
 // Debug
 void nbr_print(nbr_t *n, char *pref);
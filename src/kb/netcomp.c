@@ -3,6 +3,7 @@
 #include "constants.h"
 #include "err.h"
 #include "kb_math.h"
+#include "kb_fastmath.h"
 #include "nbi.h"
 
 /*! netcomp_init
@@ -18,6 +19,9 @@ netcomp_init(netcomp_t *comp)
     comp->coverage = 0.0f;
     comp->max_nbr = NULL;
     comp->min_nbr = NULL;
+    comp->anchor = NULL;
+    comp->repulse.x = 0.0f;
+    comp->repulse.y = 0.0f;
 
 err:
     return;
@@ -34,9 +38,11 @@ netcomp_check_full(nbrs_info_t *nbi, netcomp_t *comp)
     ASSERT_OR_ERR(comp, err, KB_ERR_INPUT);
 
     // from reference, most ccw
-    float amax = norm_angle(atan2(comp->max_nbr->loc.y, comp->max_nbr->loc.x));
+    point_t max_loc = NBI_NBR_LOC(nbi, comp->max_nbr->idx);
+    float amax = norm_angle(kb_atan2(max_loc.y, max_loc.x));
     // from reference, most cw
-    float amin = norm_angle(atan2(comp->min_nbr->loc.y, comp->min_nbr->loc.x));
+    point_t min_loc = NBI_NBR_LOC(nbi, comp->min_nbr->idx);
+    float amin = norm_angle(kb_atan2(min_loc.y, min_loc.x));
 
     comp->start_angle = center_angle(amin);
     comp->coverage = norm_angle(amax - amin);
@@ -63,7 +69,8 @@ netcomp_update(
     netcomp_t *comp,
     nbr_t *nbr)
 {
-    float angle = norm_angle(atan2(nbr->loc.y, nbr->loc.x));
+    point_t loc = NBI_NBR_LOC(nbi, nbr->idx);
+    float angle = norm_angle(kb_atan2(loc.y, loc.x));
     float neg_angle = neg_norm_angle(angle);
 
     // should be positive if angle is less than pi ccw from the end
@@ -102,7 +109,7 @@ netcomp_contains(
     netcomp_t *comp,
     point_t *pt)
 {
-    float angle = atan2(pt->y, pt->x);
+    float angle = kb_atan2(pt->y, pt->x);
     return ((angle >= comp->start_angle)
          && (angle <= (comp->start_angle + comp->coverage)));
 }
@@ -121,6 +128,9 @@ netcomp_print(netcomp_t *comp, char *pref)
     printf("%s\tcoverage: %0.4f\n", pref, comp->coverage);
     printf("%s\tmax_nbr: %p\n", pref, comp->max_nbr);
     printf("%s\tmin_nbr: %p\n", pref, comp->min_nbr);
+    printf("%s\tanchor: %p\n", pref, comp->anchor);
+    printf("%s\trepulse: (%0.4f, %0.4f)\n", pref, comp->repulse.x,
+           comp->repulse.y);
 
 err:
     return;
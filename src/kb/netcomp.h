@@ -35,6 +35,20 @@ typedef struct netcomp_t {
      * Pointer to most cw neighbor in component
      */
     nbr_t *min_nbr;
+
+    /*! anchor
+     *
+     * Smallest-index neighbor in the component. It is the one placed
+     * on the x-axis when the component is localized.
+     */
+    nbr_t *anchor;
+
+    /*! repulse
+     *
+     * Sum of the repulsion terms of the localized members, in the
+     * component reference frame. Kept up to date as members move.
+     */
+    point_t repulse;
 } netcomp_t;
 
 // Constructor
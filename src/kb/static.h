@@ -3,7 +3,7 @@
 
 // Neighbor info array static allocations
 extern nbr_t       _static_nbi_nbrs[];
-extern float       _static_nbi_pd_data[];
+extern uint16_t    _static_nbi_pd_data[];
 extern float       _static_nbi_last_pd_data[];
 extern uint8_t     _static_nbi_adj_data[];
 
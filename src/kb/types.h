@@ -16,4 +16,12 @@ typedef struct point_t {
     kb_pos_t x, y;
 } point_t;
 
+// motion actions, set by the state machine and dead-reckoned by nbi
+#define SA_STOP      0x0
+#define SA_FORWARD   0x1
+#define SA_RIGHT     0x2
+#define SA_LEFT      0x3
+#define SA_FWD_RIGHT 0x4
+#define SA_FWD_LEFT  0x5
+
 #endif
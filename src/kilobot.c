@@ -8,6 +8,16 @@
 
 #include <kilolib.h>
 
+#ifdef KB_SNAPSHOT
+#include "snapshot.h"
+
+/*! snapshot_f
+ *
+ * File every tick's state snapshot is appended to
+ */
+FILE *snapshot_f;
+#endif
+
 /*! state
  *
  * Global state for the program
@@ -25,6 +35,12 @@ void setup()
     rand_seed(rand_hard());
     // initialize the state
     state_init(&state);
+
+#ifdef KB_SNAPSHOT
+    char fname[32];
+    sprintf(fname, "snapshot_%x.bin", kilo_uid);
+    snapshot_f = fopen(fname, "wb");
+#endif
 }
 
 /*! loop
@@ -36,9 +52,26 @@ void loop()
     // update the current time
     state.ticks = kilo_ticks;
 
+    // carry the neighborhood along with however we moved since last tick
+    nbi_odom_update(state.nbi, state.a, state.ticks);
+
+    // take in everything the rx callback staged since last tick
+    msg_rx_apply(&state);
+
+    // drop neighbors we haven't heard from in too long
+    nbi_expire_nbrs(state.nbi, state.ticks);
+
     // print the state before each loop
     /*state_print(&state);*/
 
+#ifdef KB_SNAPSHOT
+    // or dump it in binary, cheap enough to do every tick. decode
+    // offline with snapdec
+    if (snapshot_f) {
+        snapshot_write(&state, snapshot_file_sink, snapshot_f);
+    }
+#endif
+
     // if the state is new, run the setup function
     if (state_flag_is_set(&state, SF_NEW_STATE)) {
         state.setup(&state);
@@ -55,6 +88,9 @@ void loop()
     // loop or led functions, clear it anyway so it's valid
     // each loop
     state_clr_flag(&state, SF_MSG_SENT);
+
+    // everything this tick has been seen, start a new journal
+    nbi_journal_reset(state.nbi);
 }
 
 /*! message_rx
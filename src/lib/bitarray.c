@@ -20,7 +20,7 @@ ba_create(
     ASSERT_OR_ERR(ba, err, KB_ERR_OOM);
 
     // size/8 rounded up
-    uint32_t nchars = (size + sizeof(uint8_t) - 1) / sizeof(uint8_t);
+    uint32_t nchars = (size + 7) / 8;
     uint8_t *data = (uint8_t*)calloc(nchars, sizeof(uint8_t));
 
     ba_init(ba, size, data, nchars);
@@ -40,7 +40,7 @@ ba_init(
     uint8_t *data,
     uint32_t data_sz)
 {
-    uint32_t nchars = (size + sizeof(uint8_t) - 1) / sizeof(uint8_t);
+    uint32_t nchars = (size + 7) / 8;
     ASSERT_OR_ERR(ba && size > 0 && data && data_sz == nchars,
             err, KB_ERR_INPUT);
 
@@ -216,7 +216,8 @@ bm_create(
     ASSERT_OR_ERR(bm, err, KB_ERR_OOM);
 
     uint32_t sz = _bm_get_size(n, m, type);
-    uint32_t nchars = (sz + sizeof(uint8_t) - 1) / sizeof(uint8_t);
+    // sz/8 rounded up
+    uint32_t nchars = (sz + 7) / 8;
     uint8_t *data = (uint8_t*)calloc(nchars, sizeof(uint8_t));
     ASSERT_OR_ERR(data, err, KB_ERR_OOM);
 
@@ -241,7 +242,7 @@ bm_init(
     uint32_t data_sz)
 {
     uint32_t sz = _bm_get_size(n, m, type);
-    uint32_t nchars = (sz + sizeof(uint8_t) - 1) / sizeof(uint8_t);
+    uint32_t nchars = (sz + 7) / 8;
     ASSERT_OR_ERR(bm && n > 0 && data && data_sz == nchars,
             err, KB_ERR_INPUT);
 
@@ -338,12 +339,50 @@ err:
     return;
 }
 
+/*! bm_get_row
+ *
+ * Gather row i into a single word, column j in bit j. Only valid
+ * for matrices with at most 64 columns.
+ */
+uint64_t
+bm_get_row(
+    bitmat_t *bm,
+    uint32_t i)
+{
+    ASSERT_OR_ERR(bm && i < bm->n && bm->m <= 64, err, KB_ERR_INPUT);
+
+    uint64_t row = 0;
+    uint32_t start = _bm_get_idx(bm, i, 0);
+
+    // byte aligned rows can be pulled out a byte at a time
+    if (start % 8 == 0) {
+        for (uint32_t j = 0; j < bm->m; j += 8) {
+            row |= (uint64_t)bm->raw.data[(start + j) / 8] << j;
+        }
+        if (bm->m < 64) {
+            row &= ((uint64_t)1 << bm->m) - 1;
+        }
+    } else {
+        for (uint32_t j = 0; j < bm->m; ++j) {
+            if (ba_is_set(&bm->raw, start + j)) {
+                row |= (uint64_t)1 << j;
+            }
+        }
+    }
+
+    return row;
+err:
+    return 0;
+}
+
 /*! bm_mult
  *
  * Multiply two bit matrices
  *
- * Note: currently only implemented for symmetric matrices, also
- * requires dimension be a multiple of 8 so we can work in bytes
+ * Note: currently only implemented for symmetric matrices. When the
+ * dimension is a multiple of 8 rows are combined a byte at a time,
+ * otherwise rows don't start on a byte boundary and we fall back to
+ * working a bit at a time.
  */
 void
 bm_mult(
@@ -351,12 +390,26 @@ bm_mult(
     bitmat_t *b,
     bitmat_t *c)
 {
-    ASSERT_OR_ERR(a && b, err, KB_ERR_INPUT);
+    ASSERT_OR_ERR(a && b && c, err, KB_ERR_INPUT);
     ASSERT_OR_ERR(a->type == BM_SYMMETRIC, err, KB_ERR_INPUT);
     ASSERT_OR_ERR(b->type == BM_SYMMETRIC, err, KB_ERR_INPUT);
-    ASSERT_OR_ERR(a->n % 8 == 0 && a->n / 8 >= 1, err, KB_ERR_INPUT);
     ASSERT_OR_ERR(a->n == b->n && a->n == c->n, err, KB_ERR_INPUT);
 
+    if (a->n % 8 != 0) {
+        uint32_t n = a->n;
+        for (uint32_t i = 0; i < n; ++i) {
+            for (uint32_t j = 0; j < n; ++j) {
+                if (!ba_is_set(&a->raw, i*n + j)) continue;
+                for (uint32_t k = 0; k < n; ++k) {
+                    if (ba_is_set(&b->raw, j*n + k)) {
+                        ba_set(&c->raw, i*n + k);
+                    }
+                }
+            }
+        }
+        return;
+    }
+
     uint32_t ch_per_row = (c->n / 8);
     // compute each byte one by one
     for (uint32_t ch = 0; ch < a->raw.sz / 8; ++ ch) {
@@ -395,7 +448,7 @@ bm_copy(
             && dest->type == src->type,
             err, KB_ERR_INPUT);
 
-    uint32_t nchars = (src->raw.sz + sizeof(uint8_t) - 1) / sizeof(uint8_t);
+    uint32_t nchars = (src->raw.sz + 7) / 8;
     memcpy(dest->raw.data, src->raw.data, nchars);
 
 err:
@@ -414,7 +467,7 @@ bm_fill(
 {
     ASSERT_OR_ERR(bm, err, KB_ERR_INPUT);
 
-    uint32_t nchars = (bm->raw.sz + sizeof(uint8_t) - 1) / sizeof(uint8_t);
+    uint32_t nchars = (bm->raw.sz + 7) / 8;
     memset(bm->raw.data, byte, nchars);
 
 err:
@@ -82,6 +82,7 @@ void bm_delete(bitmat_t *bm);
 bool bm_is_set(bitmat_t *bm, uint32_t i, uint32_t j);
 void bm_set(bitmat_t *bm, uint32_t i, uint32_t j);
 void bm_clr(bitmat_t *bm, uint32_t i, uint32_t j);
+uint64_t bm_get_row(bitmat_t *bm, uint32_t i);
 
 // Operations
 void bm_mult(bitmat_t *a, bitmat_t *b, bitmat_t *c);
@@ -4,12 +4,93 @@
 #define PI                          3.14159265359f
 #define TWO_PI                      6.28318530718f
 
+//neighbor table capacity; every per-neighbor size below is derived from
+//it. Override at build time (-DMAX_NEIGHBORS=n, or KB_MAX_NEIGHBORS in cmake)
+#ifndef MAX_NEIGHBORS
 #define MAX_NEIGHBORS               16
-#define PAIRWISE_DIST_ARR_SIZE      136
+#endif
+#if MAX_NEIGHBORS < 8 || MAX_NEIGHBORS > 64
+#error "MAX_NEIGHBORS must be in [8, 64]"
+#endif
+#define PAIRWISE_DIST_ARR_SIZE      (MAX_NEIGHBORS*(MAX_NEIGHBORS+1)/2)
 //PAIRWISE_DIST_ARR_SIZE/8 rounded up
-#define NEIGHBOR_FLAGS_BIT_ARR_SIZE 17
+#define NEIGHBOR_FLAGS_BIT_ARR_SIZE ((PAIRWISE_DIST_ARR_SIZE + 7)/8)
+//log2 of the id->slot index size; index must hold at least 2*MAX_NEIGHBORS
+#if MAX_NEIGHBORS <= 8
+#define NBI_ID_INDEX_BITS           4
+#elif MAX_NEIGHBORS <= 16
+#define NBI_ID_INDEX_BITS           5
+#elif MAX_NEIGHBORS <= 32
+#define NBI_ID_INDEX_BITS           6
+#else
+#define NBI_ID_INDEX_BITS           7
+#endif
+#define NBI_ID_INDEX_SIZE           (0x1 << NBI_ID_INDEX_BITS)
 #define NEIGHBOR_TIMEOUT_TICKS      256
+//timing wheel used to expire neighbors, NEIGHBOR_TIMEOUT_TICKS/NBI_WHEEL_SLOTS wide
+#define NBI_WHEEL_SLOTS             8
+#define NBI_WHEEL_WIDTH             (NEIGHBOR_TIMEOUT_TICKS / NBI_WHEEL_SLOTS)
 #define COORD_UPDATE_INTERVAL       128
+//edges of each kind the per-tick change journal can hold before overflowing
+#define NBI_JOURNAL_EDGES           8
+//distance filter: EMA weight is 1/2^NBI_DIST_EMA_SHIFT, kept with
+//NBI_DIST_FRAC_BITS fractional bits. pd only follows the filtered value
+//once it has moved at least NBI_DIST_HYST away from it
+#define NBI_DIST_EMA_SHIFT          2
+#define NBI_DIST_FRAC_BITS          4
+#define NBI_DIST_HYST               2
+//neighbor updates staged between the rx callback and the loop, power of 2
+//(at most 128). By default room for an update from every neighbor
+//between two loop ticks
+#ifndef NBI_RX_RING_SIZE
+#if MAX_NEIGHBORS <= 8
+#define NBI_RX_RING_SIZE            8
+#elif MAX_NEIGHBORS <= 16
+#define NBI_RX_RING_SIZE            16
+#elif MAX_NEIGHBORS <= 32
+#define NBI_RX_RING_SIZE            32
+#else
+#define NBI_RX_RING_SIZE            64
+#endif
+#endif
+//staged updates applied per nbi_rx_apply call, at most 8
+#define NBI_RX_BATCH_SIZE           8
+//distance ages run on a clock that ticks NBI_DIST_AGE_MOVING times
+//faster while we're moving, so anything measured before a move looks
+//old. Ages saturate at around NBI_DIST_AGE_MAX (a power of 2), and
+//localization only steers clear of references older than
+//NBI_DIST_AGE_STALE
+#define NBI_DIST_AGE_MOVING         4
+#define NBI_DIST_AGE_MAX            0x4000
+#define NBI_DIST_AGE_STALE          256
+//(via, two-hop id, distance) entries remembered for robots we've heard
+//gossip about but not from
+#ifndef NBI_TWO_HOP_SIZE
+#define NBI_TWO_HOP_SIZE            (MAX_NEIGHBORS / 2)
+#endif
+//disconnected components tracked in the local subgraph, beyond that
+//there isn't enough information to compute anything
+#define NBI_MAX_COMPS               5
+//odometry model, per kilo_tick: mm driven straight, rad turned while
+//pivoting and mm from the body center to the pivot leg. A distance
+//update within ODOM_DIST_TOL of what the predicted locations give
+//doesn't force a new localization pass
+#define ODOM_FWD_RATE               0.3f
+#define ODOM_TURN_RATE              0.025f
+#define ODOM_PIVOT_R                16.0f
+#define ODOM_DIST_TOL               4
+//a trilaterated location further than this (mm) from our own range to
+//the point came from references too close to in line with us
+#define LOC_RESIDUAL_MAX            10
+//sine of the smallest angle two references may make through us to be
+//trilaterated from as a pair
+#ifndef LOC_PAIR_SIN_MIN
+#define LOC_PAIR_SIN_MIN            0.02f
+#endif
+//most references a neighbor is fit to by least squares
+#ifndef LOC_MAX_REFS
+#define LOC_MAX_REFS                6
+#endif
 #define UNKNOWN_DIST                0xffff
 #define INVALID_INDEX               0xdead
 #define INVALID_SIZE                INVALID_INDEX
@@ -28,7 +109,8 @@
 #define STATIC_SIZE_MSG_Q_RAW_LIST 128
 #define STATIC_SIZE_MD_LIST        STATIC_SIZE_MSG_Q_RAW_LIST
 #define STATIC_SIZE_NBI_NBRS       MAX_NEIGHBORS
-#define STATIC_SIZE_NBI_PD_DATA    MAX_NEIGHBORS*(MAX_NEIGHBORS+1)/2
-#define STATIC_SIZE_NBI_ADJ_DATA   (MAX_NEIGHBORS*MAX_NEIGHBORS + sizeof(uint8_t) - 1)/sizeof(uint8_t)
+#define STATIC_SIZE_NBI_PD_DATA    PAIRWISE_DIST_ARR_SIZE
+//one bit per (i, j) pair, rounded up to whole bytes
+#define STATIC_SIZE_NBI_ADJ_DATA   ((MAX_NEIGHBORS*MAX_NEIGHBORS + 7)/8)
 
 #endif
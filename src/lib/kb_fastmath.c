@@ -0,0 +1,124 @@
+#include "kb_fastmath.h"
+
+#include <math.h>
+
+#include "constants.h"
+#include "types.h"
+
+#ifdef KB_FASTMATH
+
+/*! kb_atan2
+ *
+ * atan2 from an odd polynomial for atan on [0, 1] (Abramowitz and
+ * Stegun 4.4.49), moved out to the right octant
+ */
+float
+kb_atan2(
+    float y,
+    float x)
+{
+    float ax = fabsf(x);
+    float ay = fabsf(y);
+    if (ax == 0.0f && ay == 0.0f) {
+        return 0.0f;
+    }
+
+    // keep the ratio in [0, 1]
+    bool swap = ay > ax;
+    float z = swap? ax / ay : ay / ax;
+    float z2 = z*z;
+    float a = z * (0.9998660f + z2 * (-0.3302995f + z2 * (0.1801410f
+        + z2 * (-0.0851330f + z2 * 0.0208351f))));
+
+    if (swap) {
+        a = 0.5f * PI - a;
+    }
+    if (x < 0.0f) {
+        a = PI - a;
+    }
+    return (y < 0.0f)? -a : a;
+}
+
+/*! kb_sincos
+ *
+ * Sine and cosine of theta at once. theta is brought to within pi/4
+ * of a multiple of pi/2 (in two steps, to keep the bits the first one
+ * cancels), where both Taylor series converge quickly
+ */
+void
+kb_sincos(
+    float theta,
+    float *s,
+    float *c)
+{
+    float q = theta * (2.0f / PI);
+    int32_t k = (int32_t)((q < 0.0f)? q - 0.5f : q + 0.5f);
+    float r = (theta - k * 1.5703125f) - k * 4.83826794897e-4f;
+
+    float r2 = r*r;
+    float sr = r * (1.0f + r2 * (-1.0f/6.0f + r2 * (1.0f/120.0f
+        + r2 * (-1.0f/5040.0f))));
+    float cr = 1.0f + r2 * (-0.5f + r2 * (1.0f/24.0f + r2 * (-1.0f/720.0f
+        + r2 * (1.0f/40320.0f))));
+
+    switch (k & 0x3) {
+    case 0: *s =  sr; *c =  cr; break;
+    case 1: *s =  cr; *c = -sr; break;
+    case 2: *s = -sr; *c = -cr; break;
+    default: *s = -cr; *c =  sr; break;
+    }
+}
+
+/*! kb_acos
+ *
+ * acos from sqrt(1 - x) times a cubic on [0, 1] (Abramowitz and
+ * Stegun 4.4.45), reflected for negative x
+ */
+float
+kb_acos(float x)
+{
+    float ax = fabsf(x);
+    float a = sqrtf(1.0f - ax) * (1.5707288f + ax * (-0.2121144f
+        + ax * (0.0742610f + ax * -0.0187293f)));
+    return (x < 0.0f)? PI - a : a;
+}
+
+#else
+
+/*! kb_atan2
+ *
+ * libm atan2
+ */
+float
+kb_atan2(
+    float y,
+    float x)
+{
+    return atan2f(y, x);
+}
+
+/*! kb_sincos
+ *
+ * libm sin and cos
+ */
+void
+kb_sincos(
+    float theta,
+    float *s,
+    float *c)
+{
+    *s = sinf(theta);
+    *c = cosf(theta);
+}
+
+/*! kb_acos
+ *
+ * libm acos
+ */
+float
+kb_acos(float x)
+{
+    return acosf(x);
+}
+
+#endif
@@ -0,0 +1,23 @@
+/*! file: kb_fastmath.h
+ *
+ * Trigonometry for the localization hot path. On the robot atan2, sin,
+ * cos and acos are soft-float library calls costing thousands of
+ * cycles each. Built with KB_FASTMATH these are short polynomials
+ * instead, otherwise they go straight to libm.
+ *
+ * Worst case absolute error with KB_FASTMATH, in radians (or for
+ * kb_sincos, in the result):
+ *
+ *      kb_atan2    1.2e-5
+ *      kb_sincos   4e-7 for |theta| <= 64pi
+ *      kb_acos     6.8e-5, NaN outside [-1, 1] as acos
+ */
+
+#ifndef __KB_FASTMATH_H__
+#define __KB_FASTMATH_H__
+
+float kb_atan2(float y, float x);
+void kb_sincos(float theta, float *s, float *c);
+float kb_acos(float x);
+
+#endif
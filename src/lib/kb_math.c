@@ -1,9 +1,9 @@
 #include "kb_math.h"
 
-// acos
 #include <math.h>
 
 #include "constants.h"
+#include "kb_fastmath.h"
 
 /*! l2_sq
  *
@@ -40,7 +40,7 @@ angled(
     float dac = (float) ac;
     float dbc = (float) bc;
     float gamma = (dab*dab + dac*dac - dbc*dbc)/(2.0*dab*dac);
-    gamma = acos(gamma);
+    gamma = kb_acos(gamma);
     return gamma;
 }
 
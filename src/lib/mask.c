@@ -0,0 +1,68 @@
+#include "mask.h"
+
+#include "constants.h"
+
+/*! mask_first
+ *
+ * Index of the lowest set bit, or INVALID_INDEX if none are set
+ */
+uint32_t
+mask_first(kb_mask_t m)
+{
+    if (m == MASK_NONE) {
+        return INVALID_INDEX;
+    }
+    return __builtin_ctzll((unsigned long long)m);
+}
+
+/*! mask_last
+ *
+ * Index of the highest set bit, or INVALID_INDEX if none are set
+ */
+uint32_t
+mask_last(kb_mask_t m)
+{
+    if (m == MASK_NONE) {
+        return INVALID_INDEX;
+    }
+    return 63 - __builtin_clzll((unsigned long long)m);
+}
+
+/*! mask_count
+ *
+ * Number of set bits
+ */
+uint32_t
+mask_count(kb_mask_t m)
+{
+    return __builtin_popcountll((unsigned long long)m);
+}
+
+/*! mask_pop
+ *
+ * Clear the lowest set bit of *m and return its index, or INVALID_INDEX
+ * once *m is empty. Walks a mask in slot order:
+ *
+ *  for (uint32_t i; (i = mask_pop(&m)) != INVALID_INDEX; ) { ... }
+ */
+uint32_t
+mask_pop(kb_mask_t *m)
+{
+    uint32_t i = mask_first(*m);
+    *m &= *m - 1;
+    return i;
+}
+
+/*! mask_nth
+ *
+ * Index of the n-th (from 0) lowest set bit, or INVALID_INDEX if fewer
+ * than n+1 are set
+ */
+uint32_t
+mask_nth(kb_mask_t m, uint32_t n)
+{
+    for (; n > 0 && m != MASK_NONE; --n) {
+        m &= m - 1;
+    }
+    return mask_first(m);
+}
@@ -0,0 +1,33 @@
+#ifndef MASK_H
+#define MASK_H
+
+#include "types.h"
+#include "constants.h"
+
+/*! kb_mask_t
+ *
+ * One bit per neighbor slot. Sized to the smallest word that can
+ * hold MAX_NEIGHBORS bits.
+ */
+#if MAX_NEIGHBORS <= 16
+typedef uint16_t kb_mask_t;
+#elif MAX_NEIGHBORS <= 32
+typedef uint32_t kb_mask_t;
+#else
+typedef uint64_t kb_mask_t;
+#endif
+
+#define MASK_NONE           ((kb_mask_t)0)
+#define MASK_BIT(i)         ((kb_mask_t)1 << (i))
+#define MASK_IS_SET(m, i)   (((m) & MASK_BIT(i)) != 0)
+#define MASK_LOW(n)         ((n) >= 8*sizeof(kb_mask_t)? \
+                                ~MASK_NONE : MASK_BIT(n) - 1)
+
+// Bit operations
+uint32_t mask_first(kb_mask_t m);
+uint32_t mask_last(kb_mask_t m);
+uint32_t mask_count(kb_mask_t m);
+uint32_t mask_pop(kb_mask_t *m);
+uint32_t mask_nth(kb_mask_t m, uint32_t n);
+
+#endif
@@ -164,7 +164,8 @@ matf_fill(
 {
     ASSERT_OR_ERR(m, err, KB_ERR_INPUT);
 
-    memset(m->data, byte, _matf_get_size(m->n, m->m, m->type));
+    memset(m->data, byte,
+            _matf_get_size(m->n, m->m, m->type)*sizeof(float));
 
 err:
     return;
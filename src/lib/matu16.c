@@ -0,0 +1,232 @@
+#include "matu16.h"
+
+// free
+#include <stdlib.h>
+// memcpy
+#include <string.h>
+
+#include "constants.h"
+#include "err.h"
+
+static uint32_t
+_matu16_get_size(
+    uint32_t n,
+    uint32_t m,
+    uint8_t type)
+{
+    switch (type) {
+        case MATU16_SYMMETRIC:
+            return n*(n+1) / 2;
+        case MATU16_DEFAULT:
+        default:
+            return n*m;
+    }
+}
+
+/*! matu16_tri_idx
+ *
+ * Index of the symmetric pair (i, j) in a packed lower triangle, the
+ * layout of a MATU16_SYMMETRIC matrix. Also used to keep arrays that
+ * run alongside one.
+ */
+uint32_t
+matu16_tri_idx(
+    uint32_t i,
+    uint32_t j)
+{
+    uint32_t sm = (i > j? j : i);
+    uint32_t lg = (i > j? i : j);
+    return lg*(lg + 1) / 2 + sm;
+}
+
+/*! _matu16_get_idx
+ *
+ * Index of (i, j) in the data array. For a symmetric matrix this is
+ * the lower triangle entry (lg, sm).
+ */
+static uint32_t
+_matu16_get_idx(
+    matu16_t *m,
+    uint32_t i,
+    uint32_t j)
+{
+    if (m->type == MATU16_SYMMETRIC) {
+        return matu16_tri_idx(i, j);
+    }
+    return i*m->m + j;
+}
+
+/*! matu16_init
+ *
+ * In-place constructor
+ */
+void
+matu16_init(
+    matu16_t *mat,
+    uint32_t n,
+    uint32_t m,
+    uint8_t type,
+    uint16_t *data,
+    uint32_t data_sz)
+{
+    ASSERT_OR_ERR(mat && n > 0
+            && data && data_sz == _matu16_get_size(n, (m == 0? n : m), type),
+            err, KB_ERR_INPUT);
+
+    mat->n = n;
+    mat->m = (m == 0? n : m);
+    mat->type = type;
+    mat->data = data;
+
+err:
+    return;
+}
+
+/*! matu16_delete
+ *
+ * Destructor
+ */
+void
+matu16_delete(matu16_t *mat)
+{
+    if (mat) {
+        if (mat->data) {
+            free(mat->data);
+        }
+        free(mat);
+    }
+}
+
+/*! matu16_get
+ *
+ * Accessor
+ */
+uint16_t
+matu16_get(
+    matu16_t *m,
+    uint32_t i,
+    uint32_t j)
+{
+    ASSERT_OR_ERR(m && i < m->n && j < m->m,
+            err, KB_ERR_INPUT);
+
+    return m->data[_matu16_get_idx(m, i, j)];
+err:
+    return 0;
+}
+
+/*! matu16_set
+ *
+ * Mutator
+ */
+void
+matu16_set(
+    matu16_t *m,
+    uint32_t i,
+    uint32_t j,
+    uint16_t val)
+{
+    ASSERT_OR_ERR(m && i < m->n && j < m->m,
+            err, KB_ERR_INPUT);
+
+    m->data[_matu16_get_idx(m, i, j)] = val;
+
+err:
+    return;
+}
+
+/*! matu16_get_row
+ *
+ * Copy the first row_sz entries of row i into row. For a symmetric
+ * matrix (i, 0..i) is one block copy and the rest of the row steps
+ * down column i.
+ *
+ * @return Number of entries copied
+ */
+uint32_t
+matu16_get_row(
+    matu16_t *m,
+    uint32_t i,
+    uint16_t *row,
+    uint32_t row_sz)
+{
+    ASSERT_OR_ERR(m && i < m->n && row, err, KB_ERR_INPUT);
+
+    uint32_t len = (row_sz < m->m? row_sz : m->m);
+    if (m->type != MATU16_SYMMETRIC) {
+        memcpy(row, &m->data[i*m->m], len*sizeof(uint16_t));
+        return len;
+    }
+
+    uint32_t head = (len < i + 1? len : i + 1);
+    memcpy(row, &m->data[i*(i + 1) / 2], head*sizeof(uint16_t));
+
+    // (j, i) for j > i, each a row further down
+    uint32_t idx = (i + 1)*(i + 2) / 2 + i;
+    for (uint32_t j = i + 1; j < len; ++j) {
+        row[j] = m->data[idx];
+        idx += j + 1;
+    }
+    return len;
+
+err:
+    return 0;
+}
+
+/*! matu16_fill
+ *
+ * Set every entry to val
+ */
+void
+matu16_fill(
+    matu16_t *m,
+    uint16_t val)
+{
+    ASSERT_OR_ERR(m, err, KB_ERR_INPUT);
+
+    uint32_t size = _matu16_get_size(m->n, m->m, m->type);
+    for (uint32_t k = 0; k < size; ++k) {
+        m->data[k] = val;
+    }
+
+err:
+    return;
+}
+
+/*! matu16_print
+ *
+ * Print the matrix
+ */
+void
+matu16_print(matu16_t *m, char *pref)
+{
+    ASSERT_OR_ERR(m && pref, err, KB_ERR_INPUT);
+
+    printf("%smatu16: %p\n", pref, m);
+    printf("%s\tdim: %dx%d\n", pref, m->n, m->m);
+    printf("%s\ttype: ", pref);
+    switch (m->type) {
+        case MATU16_DEFAULT:
+            printf("default");
+            break;
+
+        case MATU16_SYMMETRIC:
+            printf("symmetric");
+            break;
+
+        default:
+            printf("unknown");
+    }
+    printf("\n");
+    printf("%s\tdata: %p\n", pref, m->data);
+    for (uint32_t i = 0; i < m->n; ++i) {
+        printf("%s\t\t", pref);
+        for (uint32_t j = 0; j < m->m; ++j) {
+            printf("%-6u", matu16_get(m, i, j));
+        }
+        printf("\n");
+    }
+
+err:
+    return;
+}
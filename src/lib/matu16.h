@@ -0,0 +1,57 @@
+#ifndef MATU16_H
+#define MATU16_H
+
+#include "types.h"
+
+/*! matu16_t
+ *
+ * flat uint16_t matrix structure. Symmetric matrices keep only the
+ * lower triangle, row by row, so row i holds (i, 0..i) contiguously.
+ */
+typedef struct matu16_t {
+    /*! n,m
+     *
+     * Matrix dimensions
+     */
+    uint32_t n;
+    uint32_t m;
+
+#define MATU16_DEFAULT      0x0
+#define MATU16_SYMMETRIC    0x1
+
+    /*! flags
+     *
+     * Matrix type, for various optimizations
+     */
+    uint8_t type;
+
+    /*! rsvd
+     *
+     * Explicit padding
+     */
+    uint8_t rsvd[3];
+
+    /*! data
+     *
+     * Raw data array
+     */
+    uint16_t *data;
+} matu16_t;
+
+// Constructors/Destructor
+void matu16_init(matu16_t *mat, uint32_t n, uint32_t m, uint8_t type,
+                 uint16_t *data, uint32_t data_sz);
+void matu16_delete(matu16_t *mat);
+
+// Accessor/Mutator
+uint16_t matu16_get(matu16_t *m, uint32_t i, uint32_t j);
+void matu16_set(matu16_t *m, uint32_t i, uint32_t j, uint16_t val);
+uint32_t matu16_get_row(matu16_t *m, uint32_t i, uint16_t *row,
+                        uint32_t row_sz);
+void matu16_fill(matu16_t *m, uint16_t val);
+uint32_t matu16_tri_idx(uint32_t i, uint32_t j);
+
+// Debug
+void matu16_print(matu16_t *m, char *pref);
+
+#endif
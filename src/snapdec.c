@@ -0,0 +1,93 @@
+/*! file: snapdec.c
+ *
+ * Offline decoder for state snapshots. Reads a stream of them from a
+ * file (or stdin) and prints each one with state_print, the same as
+ * the robot would have.
+ *
+ * usage: snapdec [snapshot file]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "state.h"
+#include "snapshot.h"
+#include "fifo.h"
+#include "msg.h"
+
+#include <kilolib.h>
+
+/*! state
+ *
+ * State object each snapshot is decoded into
+ */
+state_t state;
+
+int
+main(int argc, char **argv)
+{
+    FILE *f = stdin;
+    if (argc > 1) {
+        f = fopen(argv[1], "rb");
+        if (!f) {
+            fprintf(stderr, "snapdec: can't open %s\n", argv[1]);
+            return 1;
+        }
+    }
+
+    // slurp the whole stream, snapshots are variable length
+    uint32_t len = 0;
+    uint32_t cap = 4096;
+    uint8_t *buf = (uint8_t*)malloc(cap);
+    size_t n;
+    while (buf && (n = fread(buf + len, 1, cap - len, f)) > 0) {
+        len += n;
+        if (len == cap) {
+            cap *= 2;
+            uint8_t *grown = (uint8_t*)realloc(buf, cap);
+            if (!grown) {
+                free(buf);
+            }
+            buf = grown;
+        }
+    }
+    if (f != stdin) {
+        fclose(f);
+    }
+    if (!buf) {
+        fprintf(stderr, "snapdec: out of memory\n");
+        return 1;
+    }
+
+    uint32_t pos = 0;
+    uint32_t n_snaps = 0;
+    uint32_t skipped = 0;
+    while (pos < len) {
+        // start every snapshot from a clean state
+        msg_data_t *md;
+        while (state.msg_q && (md = (msg_data_t*)fifo_pop(state.msg_q))) {
+            msg_data_delete(md);
+        }
+        state_init(&state);
+
+        uint32_t used = snapshot_read(&state, buf + pos, len - pos);
+        if (used == 0) {
+            // damaged or truncated, look for the next one
+            ++pos;
+            ++skipped;
+            continue;
+        }
+        pos += used;
+        ++n_snaps;
+
+        state_print(&state);
+    }
+
+    if (skipped) {
+        fprintf(stderr, "snapdec: skipped %u bytes\n", skipped);
+    }
+    fprintf(stderr, "snapdec: %u snapshots\n", n_snaps);
+
+    free(buf);
+    return 0;
+}
@@ -4,9 +4,34 @@
 
 #include "constants.h"
 #include "kb_math.h"
+#include "kb_fastmath.h"
 
 #include "localize.h"
 #include "msg.h"
+#include "nbi.h"
+
+/*! REPULSE_MIN
+ *
+ * Repulsion magnitude below which the neighborhood is considered
+ * sparse enough to just keep driving. One neighbor at the edge of
+ * communication range.
+ */
+#define REPULSE_MIN         (1.0f / COMM_RANGE)
+
+/*! REPULSE_ALIGN
+ *
+ * Heading error, in radians, within which we drive forward instead
+ * of turning towards the repulsion vector
+ */
+#define REPULSE_ALIGN       (PI / 6.0f)
+
+/*! _loc_sched
+ *
+ * We steer by the coordinates, so redo them as soon as anyone's
+ * distance stops matching what odometry predicted, and at least every
+ * few ticks while turning
+ */
+static const localize_sched_t _loc_sched = {4, 1, LOC_MAX_REFS};
 
 typedef struct ss_avoid_t {
 } ss_avoid_t;
@@ -22,6 +47,9 @@ void
 SETUP_NAME(AVOID)(state_t *st)
 {
     st->ss = &_avoid_data;
+
+    // don't steer by whatever the last state left behind
+    localize_demand(st);
 }
 
 /*! led_avoid
@@ -36,11 +64,31 @@ LED_NAME(AVOID)(state_t *st)
 /*! state_avoid
  *
  * Handler function for S_AVOID main loop functionality
+ *
+ * Turn to face along the repulsion vector, then drive forward
  */
 void
 LOOP_NAME(AVOID)(state_t *st)
 {
-    state_set_motion(st, SA_FORWARD);
+    localize_sched(st, &_loc_sched);
+
+    point_t rep = nbi_repulsion_vec(st->nbi);
+    if (!nbi_is_localized(st->nbi)
+            || rep.x * rep.x + rep.y * rep.y < REPULSE_MIN * REPULSE_MIN)
+    {
+        state_set_motion(st, SA_FORWARD);
+        return;
+    }
+
+    float err = angle_diff(nbi_guess_orientation(st->nbi, st->a),
+                           kb_atan2(rep.y, rep.x));
+    if (fabsf(err) < REPULSE_ALIGN) {
+        state_set_motion(st, SA_FORWARD);
+    } else if (err > 0.0f) {
+        state_set_motion(st, SA_LEFT);
+    } else {
+        state_set_motion(st, SA_RIGHT);
+    }
 }
 
 /*! state_avoid_msg_rx_handler
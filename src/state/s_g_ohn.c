@@ -2,6 +2,8 @@
 
 #include <kilolib.h>
 
+#include "constants.h"
+
 #include "localize.h"
 #include "msg.h"
 #include "led.h"
@@ -17,6 +19,16 @@
  */
 #define STATIC_INTERVAL     128
 
+/*! _loc_sched
+ *
+ * The neighborhood is still filling in, so keep the coordinates
+ * fairly fresh, and catch up as soon as a couple of neighbors are
+ * waiting
+ */
+static const localize_sched_t _loc_sched = {
+    COORD_UPDATE_INTERVAL / 8, 2, LOC_MAX_REFS
+};
+
 /*! setup
  *
  * Setup function for current state
@@ -58,8 +70,8 @@ LOOP_NAME(G_OHN)(state_t *st)
         state_push_msg(st, (msg_data_t*)msg);
     }
 
-    // Compute local coordinate system
-    localize_all(st);
+    // Update the local coordinate system when it's due
+    localize_sched(st, &_loc_sched);
 
     // if there's enough info to localize
     // and we haven't gotten any new neighbors
@@ -2,12 +2,23 @@
 
 #include <kilolib.h>
 
+#include "constants.h"
 #include "led.h"
 #include "fifo.h"
 #include "localize.h"
 #include "lcv.h"
 #include "nbi.h"
 
+/*! _loc_sched
+ *
+ * The neighborhood has settled, so the coordinates only need a
+ * refresh every COORD_UPDATE_INTERVAL, or once a few neighbors have
+ * actually moved
+ */
+static const localize_sched_t _loc_sched = {
+    COORD_UPDATE_INTERVAL, 2, LOC_MAX_REFS
+};
+
 /*! setup
  *
  * Setup function for current state
@@ -16,6 +27,9 @@ void
 SETUP_NAME(LCV)(state_t *st)
 {
     /*state_print(st);*/
+
+    // start from a complete picture of the neighborhood
+    localize_demand(st);
 }
 
 /*! led_lcv
@@ -42,8 +56,8 @@ LOOP_NAME(LCV)(state_t *st)
         state_push_msg(st, (msg_data_t*)msg);
     }
 
-    // Compute local coordinate system
-    localize_all(st);
+    // Update the local coordinate system when it's due
+    localize_sched(st, &_loc_sched);
 
     // if there's enough info to localize
     // and we haven't gotten any new neighbors
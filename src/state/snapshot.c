@@ -0,0 +1,447 @@
+#include "snapshot.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "constants.h"
+#include "state.h"
+#include "msg.h"
+#include "fifo.h"
+#include "list.h"
+#include "nbi.h"
+#include "nbr.h"
+
+#include "err.h"
+
+#include <kilolib.h>
+
+/*! SNAPSHOT_NONE
+ *
+ * Slot index written for a missing neighbor/component reference
+ */
+#define SNAPSHOT_NONE       0xff
+
+/*! _snap_w_t
+ *
+ * Writer state. Bytes are gathered in a small buffer and handed to the
+ * sink in chunks, so the whole snapshot never has to sit in memory.
+ */
+typedef struct _snap_w_t {
+    snapshot_sink_t *sink;
+    void *ctx;
+    uint8_t buf[32];
+    uint32_t len;
+    uint32_t total;
+} _snap_w_t;
+
+/*! _snap_r_t
+ *
+ * Reader state. ok drops to false on the first read past the end.
+ */
+typedef struct _snap_r_t {
+    const uint8_t *buf;
+    uint32_t len;
+    uint32_t pos;
+    bool ok;
+} _snap_r_t;
+
+static void
+_snap_flush(_snap_w_t *w)
+{
+    if (w->len > 0) {
+        w->sink(w->buf, w->len, w->ctx);
+        w->total += w->len;
+        w->len = 0;
+    }
+}
+
+static void
+_snap_put_u8(_snap_w_t *w, uint8_t v)
+{
+    if (w->len == sizeof(w->buf)) {
+        _snap_flush(w);
+    }
+    w->buf[w->len++] = v;
+}
+
+// multi-byte values are always little-endian
+static void
+_snap_put_u16(_snap_w_t *w, uint16_t v)
+{
+    _snap_put_u8(w, v & 0xff);
+    _snap_put_u8(w, v >> 8);
+}
+
+static void
+_snap_put_u32(_snap_w_t *w, uint32_t v)
+{
+    _snap_put_u16(w, v & 0xffff);
+    _snap_put_u16(w, v >> 16);
+}
+
+static void
+_snap_put_f32(_snap_w_t *w, float v)
+{
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    _snap_put_u32(w, bits);
+}
+
+static void
+_snap_put_pt(_snap_w_t *w, point_t pt)
+{
+    _snap_put_f32(w, pt.x);
+    _snap_put_f32(w, pt.y);
+}
+
+static void
+_snap_put_mask(_snap_w_t *w, kb_mask_t v)
+{
+    for (uint32_t b = 0; b < sizeof(kb_mask_t); ++b) {
+        _snap_put_u8(w, (v >> (8*b)) & 0xff);
+    }
+}
+
+static uint8_t
+_snap_get_u8(_snap_r_t *r)
+{
+    if (r->pos >= r->len) {
+        r->ok = false;
+        return 0;
+    }
+    return r->buf[r->pos++];
+}
+
+static uint16_t
+_snap_get_u16(_snap_r_t *r)
+{
+    uint16_t lo = _snap_get_u8(r);
+    return lo | ((uint16_t)_snap_get_u8(r) << 8);
+}
+
+static uint32_t
+_snap_get_u32(_snap_r_t *r)
+{
+    uint32_t lo = _snap_get_u16(r);
+    return lo | ((uint32_t)_snap_get_u16(r) << 16);
+}
+
+static float
+_snap_get_f32(_snap_r_t *r)
+{
+    uint32_t bits = _snap_get_u32(r);
+    float v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+static point_t
+_snap_get_pt(_snap_r_t *r)
+{
+    point_t pt;
+    pt.x = _snap_get_f32(r);
+    pt.y = _snap_get_f32(r);
+    return pt;
+}
+
+static kb_mask_t
+_snap_get_mask(_snap_r_t *r)
+{
+    kb_mask_t v = 0;
+    for (uint32_t b = 0; b < sizeof(kb_mask_t); ++b) {
+        v |= (kb_mask_t)_snap_get_u8(r) << (8*b);
+    }
+    return v;
+}
+
+/*! _snap_nbr_idx
+ *
+ * Slot of nbr, or SNAPSHOT_NONE
+ */
+static uint8_t
+_snap_nbr_idx(nbr_t *nbr)
+{
+    return nbr? nbr->idx : SNAPSHOT_NONE;
+}
+
+/*! _snap_comp_idx
+ *
+ * Index of comp in the component array, or SNAPSHOT_NONE
+ */
+static uint8_t
+_snap_comp_idx(nbrs_info_t *nbi, netcomp_t *comp)
+{
+    return comp? (uint8_t)(comp - nbi->comps) : SNAPSHOT_NONE;
+}
+
+/*! snapshot_write
+ *
+ * Serialize st: the header fields, the outgoing message and queue, and
+ * the neighbor table (per-neighbor records, the pd triangle, adjacency
+ * rows, two-hop entries and components). Only live neighbors are
+ * written, so the cost follows n_nbrs rather than MAX_NEIGHBORS.
+ *
+ * @return Number of bytes handed to sink
+ */
+uint32_t
+snapshot_write(
+    state_t *st,
+    snapshot_sink_t *sink,
+    void *ctx)
+{
+    _snap_w_t w;
+    w.sink = sink;
+    w.ctx = ctx;
+    w.len = 0;
+    w.total = 0;
+    ASSERT_OR_ERR(st && sink, err, KB_ERR_INPUT);
+
+    // header
+    _snap_put_u16(&w, SNAPSHOT_MAGIC);
+    _snap_put_u8(&w, SNAPSHOT_VERSION);
+    _snap_put_u8(&w, sizeof(kb_mask_t));
+    _snap_put_u16(&w, kilo_uid);
+    _snap_put_u8(&w, st->s);
+    _snap_put_u8(&w, st->r);
+    _snap_put_u8(&w, st->a);
+    _snap_put_u8(&w, st->flags);
+    _snap_put_u32(&w, st->ticks);
+
+    // outgoing message
+    for (uint32_t i = 0; i < sizeof(st->msg->data); ++i) {
+        _snap_put_u8(&w, st->msg->data[i]);
+    }
+    _snap_put_u8(&w, st->msg->type);
+    _snap_put_u16(&w, st->msg->crc);
+
+    // message queue, head first
+    list_t *l = st->msg_q->l;
+    _snap_put_u8(&w, l->size);
+    for (list_node_t *node = l->head; node; node = node->next) {
+        const uint8_t *md = (const uint8_t*)node->data;
+        for (uint32_t i = 0; i < sizeof(msg_data_t); ++i) {
+            _snap_put_u8(&w, md[i]);
+        }
+    }
+
+    // neighbor table
+    nbrs_info_t *nbi = st->nbi;
+    _snap_put_u8(&w, nbi->n_nbrs);
+    _snap_put_u8(&w, nbi->max_nbrs);
+    _snap_put_u8(&w, nbi->pol);
+    _snap_put_u8(&w, nbi->flags);
+    _snap_put_u32(&w, nbi->journal.gen);
+    _snap_put_u32(&w, nbi->loc_runs);
+    _snap_put_u32(&w, nbi->loc_skips);
+    _snap_put_f32(&w, nbi->heading);
+    _snap_put_u16(&w, nbi->heading_frame);
+    _snap_put_pt(&w, nbi->repulse);
+
+    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
+        nbr_t *nbr = &nbi->nbrs[i];
+        _snap_put_u16(&w, NBI_NBR_ID(nbi, i));
+        _snap_put_u32(&w, NBI_NBR_LAST_TIME(nbi, i));
+        _snap_put_u8(&w, NBI_NBR_FLAGS(nbi, i));
+        _snap_put_u8(&w, nbr->hopct);
+        _snap_put_u8(&w, nbr->refs[0]);
+        _snap_put_u8(&w, nbr->refs[1]);
+        _snap_put_u16(&w, nbr->frame);
+        _snap_put_u8(&w, _snap_comp_idx(nbi, nbr->comp));
+        _snap_put_pt(&w, NBI_NBR_LOC(nbi, i));
+        _snap_put_pt(&w, nbr->last_loc);
+        _snap_put_pt(&w, nbr->repulse);
+    }
+
+    // lower triangle of pd, row by row
+    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
+        for (uint32_t j = 0; j <= i; ++j) {
+            _snap_put_u16(&w, nbi_get_dist(nbi, i, j));
+        }
+    }
+
+    for (uint32_t i = 0; i < nbi->n_nbrs; ++i) {
+        _snap_put_mask(&w, nbi_get_adj_row(nbi, i));
+    }
+
+    _snap_put_u8(&w, nbi_two_hop_count(nbi));
+    for (uint32_t k = 0; k < NBI_TWO_HOP_SIZE; ++k) {
+        nbi_two_hop_t *th = &nbi->two_hop[k];
+        if (th->via == KB_ID_INVALID) {
+            continue;
+        }
+        _snap_put_u16(&w, th->via);
+        _snap_put_u16(&w, th->id);
+        _snap_put_u16(&w, th->dist);
+        _snap_put_u32(&w, th->last_time);
+    }
+
+    _snap_put_u8(&w, nbi->n_comps);
+    for (uint32_t c = 0; c < nbi->n_comps; ++c) {
+        netcomp_t *comp = &nbi->comps[c];
+        _snap_put_f32(&w, comp->start_angle);
+        _snap_put_f32(&w, comp->coverage);
+        _snap_put_u8(&w, _snap_nbr_idx(comp->max_nbr));
+        _snap_put_u8(&w, _snap_nbr_idx(comp->min_nbr));
+        _snap_put_u8(&w, _snap_nbr_idx(comp->anchor));
+        _snap_put_pt(&w, comp->repulse);
+    }
+
+    _snap_flush(&w);
+err:
+    return w.total;
+}
+
+/*! snapshot_read
+ *
+ * Load a snapshot written by snapshot_write into st, which must have
+ * been set up with state_init and not used since. Meant for offline
+ * decoding: the neighbor table is filled in directly rather than
+ * replayed, so only what state_print shows is guaranteed to match.
+ *
+ * @return Number of bytes consumed, 0 if buf doesn't start with a
+ *         complete snapshot
+ */
+uint32_t
+snapshot_read(
+    state_t *st,
+    const uint8_t *buf,
+    uint32_t len)
+{
+    _snap_r_t r;
+    r.buf = buf;
+    r.len = len;
+    r.pos = 0;
+    r.ok = true;
+    ASSERT_OR_ERR(st && buf, err, KB_ERR_INPUT);
+
+    if (_snap_get_u16(&r) != SNAPSHOT_MAGIC
+            || _snap_get_u8(&r) != SNAPSHOT_VERSION
+            || _snap_get_u8(&r) != sizeof(kb_mask_t))
+    {
+        return 0;
+    }
+
+    kilo_uid = _snap_get_u16(&r);
+    st->s = _snap_get_u8(&r);
+    st->r = _snap_get_u8(&r);
+    st->a = _snap_get_u8(&r);
+    st->flags = _snap_get_u8(&r);
+    st->ticks = _snap_get_u32(&r);
+
+    for (uint32_t i = 0; i < sizeof(st->msg->data); ++i) {
+        st->msg->data[i] = _snap_get_u8(&r);
+    }
+    st->msg->type = _snap_get_u8(&r);
+    st->msg->crc = _snap_get_u16(&r);
+
+    uint32_t n_q = _snap_get_u8(&r);
+    for (uint32_t k = 0; k < n_q && r.ok; ++k) {
+        msg_data_t *md = msg_data_create(st, MSG_NAME(NONE));
+        ASSERT_OR_ERR(md, err, KB_ERR_OOM);
+        uint8_t *raw = (uint8_t*)md;
+        for (uint32_t i = 0; i < sizeof(msg_data_t); ++i) {
+            raw[i] = _snap_get_u8(&r);
+        }
+        state_push_msg(st, md);
+    }
+
+    nbrs_info_t *nbi = st->nbi;
+    uint32_t n_nbrs = _snap_get_u8(&r);
+    uint32_t max_nbrs = _snap_get_u8(&r);
+    ASSERT_OR_ERR(n_nbrs <= nbi->max_nbrs && max_nbrs == nbi->max_nbrs,
+            err, KB_ERR_INPUT);
+    nbi->n_nbrs = n_nbrs;
+    nbi->pol = _snap_get_u8(&r);
+    nbi->flags = _snap_get_u8(&r);
+    uint32_t gen = _snap_get_u32(&r);
+    nbi->loc_runs = _snap_get_u32(&r);
+    nbi->loc_skips = _snap_get_u32(&r);
+    nbi->heading = _snap_get_f32(&r);
+    nbi->heading_frame = _snap_get_u16(&r);
+    nbi->repulse = _snap_get_pt(&r);
+
+    uint8_t comp_idx[MAX_NEIGHBORS];
+    for (uint32_t i = 0; i < n_nbrs; ++i) {
+        nbr_t *nbr = &nbi->nbrs[i];
+        NBI_NBR_ID(nbi, i) = _snap_get_u16(&r);
+        NBI_NBR_LAST_TIME(nbi, i) = _snap_get_u32(&r);
+        NBI_NBR_FLAGS(nbi, i) = _snap_get_u8(&r);
+        if (NBI_NBR_FLAGS(nbi, i) & NBR_LOCALIZED) {
+            nbi->localized |= MASK_BIT(i);
+        }
+        nbr->hopct = _snap_get_u8(&r);
+        nbr->refs[0] = _snap_get_u8(&r);
+        nbr->refs[1] = _snap_get_u8(&r);
+        nbr->frame = _snap_get_u16(&r);
+        comp_idx[i] = _snap_get_u8(&r);
+        NBI_NBR_LOC(nbi, i) = _snap_get_pt(&r);
+        nbr->last_loc = _snap_get_pt(&r);
+        nbr->repulse = _snap_get_pt(&r);
+    }
+
+    for (uint32_t i = 0; i < n_nbrs; ++i) {
+        for (uint32_t j = 0; j <= i; ++j) {
+            nbi_set_dist(nbi, i, j, _snap_get_u16(&r));
+        }
+    }
+
+    for (uint32_t i = 0; i < n_nbrs; ++i) {
+        kb_mask_t row = _snap_get_mask(&r);
+        for (uint32_t j = 0; j < i; ++j) {
+            if (MASK_IS_SET(row, j)) {
+                nbi_set_adj(nbi, i, j);
+            }
+        }
+    }
+
+    uint32_t n_two_hop = _snap_get_u8(&r);
+    ASSERT_OR_ERR(n_two_hop <= NBI_TWO_HOP_SIZE, err, KB_ERR_INPUT);
+    for (uint32_t k = 0; k < NBI_TWO_HOP_SIZE; ++k) {
+        nbi_two_hop_t *th = &nbi->two_hop[k];
+        th->via = KB_ID_INVALID;
+        if (k < n_two_hop) {
+            th->via = _snap_get_u16(&r);
+            th->id = _snap_get_u16(&r);
+            th->dist = _snap_get_u16(&r);
+            th->last_time = _snap_get_u32(&r);
+        }
+    }
+
+    // components last, the adjacency above rebuilt its own
+    nbi->n_comps = _snap_get_u8(&r);
+    ASSERT_OR_ERR(nbi->n_comps <= NBI_MAX_COMPS, err, KB_ERR_INPUT);
+    for (uint32_t c = 0; c < nbi->n_comps; ++c) {
+        netcomp_t *comp = &nbi->comps[c];
+        comp->start_angle = _snap_get_f32(&r);
+        comp->coverage = _snap_get_f32(&r);
+        uint8_t max_i = _snap_get_u8(&r);
+        uint8_t min_i = _snap_get_u8(&r);
+        uint8_t anchor_i = _snap_get_u8(&r);
+        comp->max_nbr = (max_i < n_nbrs)? &nbi->nbrs[max_i] : NULL;
+        comp->min_nbr = (min_i < n_nbrs)? &nbi->nbrs[min_i] : NULL;
+        comp->anchor = (anchor_i < n_nbrs)? &nbi->nbrs[anchor_i] : NULL;
+        comp->repulse = _snap_get_pt(&r);
+    }
+    for (uint32_t i = 0; i < n_nbrs; ++i) {
+        nbi->nbrs[i].comp = (comp_idx[i] < nbi->n_comps)?
+            &nbi->comps[comp_idx[i]] : NULL;
+    }
+    nbi->journal.gen = gen;
+
+    return r.ok? r.pos : 0;
+err:
+    return 0;
+}
+
+/*! snapshot_file_sink
+ *
+ * Sink that appends to the FILE* passed as ctx
+ */
+void
+snapshot_file_sink(
+    const uint8_t *buf,
+    uint32_t len,
+    void *ctx)
+{
+    fwrite(buf, 1, len, (FILE*)ctx);
+}
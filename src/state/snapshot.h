@@ -0,0 +1,34 @@
+/*! file: state/snapshot.h
+ *
+ * Compact binary dump of the whole robot state, cheap enough to write
+ * every tick. snapdec turns a stream of them back into the state_print
+ * format offline.
+ */
+
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include "types.h"
+
+// Forward Declarations
+typedef struct state_t state_t;
+
+/*! SNAPSHOT_MAGIC, SNAPSHOT_VERSION
+ *
+ * Every snapshot starts with the magic and version, so a reader can
+ * find the next one in a damaged stream
+ */
+#define SNAPSHOT_MAGIC      0x4b53
+#define SNAPSHOT_VERSION    0x4
+
+// Function types
+typedef void snapshot_sink_t(const uint8_t *buf, uint32_t len, void *ctx);
+
+// Write/Read
+uint32_t snapshot_write(state_t *st, snapshot_sink_t *sink, void *ctx);
+uint32_t snapshot_read(state_t *st, const uint8_t *buf, uint32_t len);
+
+// Sinks
+void snapshot_file_sink(const uint8_t *buf, uint32_t len, void *ctx);
+
+#endif
@@ -61,12 +61,14 @@ msg_data_t _st_md_list[STATIC_SIZE_MD_LIST];
 nbrs_info_t _st_nbi;
 nbr_t _st_nbi_nbrs[STATIC_SIZE_NBI_NBRS];
 
-matf_t _st_nbi_pd;
-float _st_nbi_pd_data[STATIC_SIZE_NBI_PD_DATA];
+matu16_t _st_nbi_pd;
+uint16_t _st_nbi_pd_data[STATIC_SIZE_NBI_PD_DATA];
 
+#ifdef NBI_ADJ_BITMAT
 bitmat_t _st_nbi_adj;
 uint8_t _st_nbi_adj_data[STATIC_SIZE_NBI_ADJ_DATA];
 #endif
+#endif
 
 /*! state_init
  *
@@ -95,10 +97,13 @@ state_init(state_t *st)
 
     st->nbi = &_st_nbi;
     // init the neighbor info object
-    nbi_init(st->nbi, MAX_NEIGHBORS, POL_EVICT_OLDEST,
+    nbi_init(st->nbi, MAX_NEIGHBORS, POL_EVICT_DEFAULT,
             _st_nbi_nbrs, STATIC_SIZE_NBI_NBRS,
-            &_st_nbi_pd, _st_nbi_pd_data, STATIC_SIZE_NBI_PD_DATA,
-            &_st_nbi_adj,  _st_nbi_adj_data, STATIC_SIZE_NBI_ADJ_DATA);
+            &_st_nbi_pd, _st_nbi_pd_data, STATIC_SIZE_NBI_PD_DATA
+#ifdef NBI_ADJ_BITMAT
+            , &_st_nbi_adj,  _st_nbi_adj_data, STATIC_SIZE_NBI_ADJ_DATA
+#endif
+            );
 #else
     // dynamic allocation
 #endif
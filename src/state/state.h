@@ -35,13 +35,6 @@ typedef struct state_t
      */
     uint8_t r;
 
-#define SA_STOP      0x0
-#define SA_FORWARD   0x1
-#define SA_RIGHT     0x2
-#define SA_LEFT      0x3
-#define SA_FWD_RIGHT 0x4
-#define SA_FWD_LEFT  0x5
-
     /*! a
      *
      * Current action